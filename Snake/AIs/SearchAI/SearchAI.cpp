@@ -0,0 +1,286 @@
+#include <time.h>
+#include <cstdlib>
+#include <vector>
+#include "../../shared/SnakeGame.hpp"
+#include "../../shared/SnakeVoronoi.hpp"
+#include "../../shared/SnakeTransposition.hpp"
+
+/*
+  Lookahead AI: paranoid alpha-beta over the game core's reversible ticks.
+
+  The moves of a tick are simultaneous, so a tick is searched as our move first and then
+  the move of every live opponent in turn, all of them picking whatever is worst for us.
+  The tick itself is played with snakeMakeTick and taken back with snakeUnmakeTick, so
+  the state is copied only once per move. Positions at the start of a tick are cached in
+  a transposition table under their Zobrist key, which is kept from move to move.
+
+  Iterative deepening: depth 1, 2, .. until the time budget runs out. The best move of the
+  last finished depth is played, so there is always a move ready in time. With
+  SNAKE_NODE_BUDGET set the budget is that many nodes instead, and the moves no longer
+  depend on how fast the machine is, so tournaments and seeds replay exactly.
+  Leaves are scored by territory (see SnakeVoronoi.hpp) and length.
+*/
+
+/* Time per move when the controller doesn't have a deadline (plugins, no --deadline) */
+#define SEARCH_DEFAULT_BUDGET_MS 50
+#define SEARCH_MAX_DEPTH 64
+#define SEARCH_WIN 1000000
+/* How often the clock is read, in calls to searchTick */
+#define SEARCH_CLOCK_INTERVAL 64
+
+struct Search
+{
+  SnakeGameInfo state;
+  int player;
+  std::vector<Direction> input;
+  std::vector<SnakeUndo> undo; /* One per tick of depth */
+  SnakeVoronoi voronoi;
+  SnakeTranspositionTable table;
+  long long deadline;
+  long long nodeBudget; /* 0 when the budget is the deadline */
+  long long nodes;
+  int clockCountdown; /* Calls to searchTick left until the clock is read again */
+  bool aborted;
+};
+
+static long long nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Three quarters of the controller's deadline, the rest is for the pipes */
+static int moveBudgetMs()
+{
+  const char* deadline = getenv(SNAKE_DEADLINE_ENV);
+  int ms = deadline ? atoi(deadline) * 3 / 4 : 0;
+  return ms > 0 ? ms : SEARCH_DEFAULT_BUDGET_MS;
+}
+
+/* SNAKE_NODE_BUDGET, 0 if it isn't set */
+static long long moveBudgetNodes()
+{
+  const char* budget = getenv(SNAKE_NODE_BUDGET_ENV);
+  long long nodes = budget ? atoll(budget) : 0;
+  return nodes > 0 ? nodes : 0;
+}
+
+/* A move is hopeless if it runs into a wall or a body part that stays put this tick.
+   Tails move away unless their snake is growing, but the cell only frees up if the
+   tail is all there is on it. */
+static bool isHopeless(const SnakeGameInfo& state, int player, Direction d)
+{
+  Point p = snakeComputeNewHead(state.snakes[player].bodyParts.head(), d);
+  if(p.x < 0 || p.y < 0 || p.x >= state.levelWidth || p.y >= state.levelHeight) return true;
+  if(snakeIsCellBorder(p.x, p.y, state.level)) return true;
+  int count = state.occupancy[p.x + p.y * state.levelWidth].count;
+  if(count == 0) return false;
+  if(count > 1) return true;
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    const SnakeInfo& snake = state.snakes[eachSnake];
+    if(snake.alive && snake.growCount == 0 && snake.bodyParts.tail() == p)
+      return false;
+  }
+  return true;
+}
+
+/* The moves worth searching for player, best guess first. Returns how many. If every move
+   is hopeless, one of them is still returned so the snake has something to die with. */
+static int generateMoves(const SnakeGameInfo& state, int player, int firstMove, Direction moves[4])
+{
+  int count = 0;
+  if(firstMove >= Up && firstMove <= Right && !isHopeless(state, player, (Direction)firstMove))
+    moves[count++] = (Direction)firstMove;
+  for(int d = Up; d <= Right; ++d)
+    if(d != firstMove && !isHopeless(state, player, (Direction)d))
+      moves[count++] = (Direction)d;
+  if(count == 0) moves[count++] = Up;
+  return count;
+}
+
+/* Score of a position that isn't over yet, from the searching player's point of view */
+static int evaluate(Search& search)
+{
+  const SnakeGameInfo& state = search.state;
+  snakeVoronoiCompute(state, search.voronoi);
+  int me = search.player;
+  int bestTerritory = 0, bestLength = 0;
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    if(eachSnake == me || !state.snakes[eachSnake].alive) continue;
+    if(search.voronoi.territory[eachSnake] > bestTerritory) bestTerritory = search.voronoi.territory[eachSnake];
+    if(state.snakes[eachSnake].bodyParts.size() > bestLength) bestLength = state.snakes[eachSnake].bodyParts.size();
+  }
+  int score = (search.voronoi.territory[me] - bestTerritory) * 16;
+  score += (state.snakes[me].bodyParts.size() + state.snakes[me].growCount - bestLength) * 4;
+  /* Food we get to first is worth more the closer it is */
+  if(search.voronoi.foodDistance[me] > 0 && search.voronoi.foodDistance[me] < 32)
+    score += 32 - search.voronoi.foodDistance[me];
+  return score;
+}
+
+static bool outOfTime(Search& search)
+{
+  if(search.nodeBudget > 0){
+    search.aborted = search.nodes >= search.nodeBudget;
+    return search.aborted;
+  }
+  if(!search.aborted && --search.clockCountdown <= 0){
+    search.clockCountdown = SEARCH_CLOCK_INTERVAL;
+    search.aborted = nowNs() >= search.deadline;
+  }
+  return search.aborted;
+}
+
+/* Won and lost scores count the ticks from the root, but a table entry can be found again
+   at another ply. The table keeps them counted from the entry's own position instead. */
+static int scoreToTable(int score, int ply)
+{
+  if(score >= SEARCH_WIN - SEARCH_MAX_DEPTH) return score + ply;
+  if(score <= -SEARCH_WIN + SEARCH_MAX_DEPTH) return score - ply;
+  return score;
+}
+
+static int scoreFromTable(int score, int ply)
+{
+  if(score >= SEARCH_WIN - SEARCH_MAX_DEPTH) return score - ply;
+  if(score <= -SEARCH_WIN + SEARCH_MAX_DEPTH) return score + ply;
+  return score;
+}
+
+static int searchTick(Search& search, int ply, int depth, int alpha, int beta);
+
+/* Picks the move of opponent (and the ones after it) that is worst for us, with input
+   already holding our move. Past the last opponent the tick is played. */
+static int searchOpponents(Search& search, int opponent, int ply, int depth, int alpha, int beta)
+{
+  SnakeGameInfo& state = search.state;
+  while(opponent < (int)state.snakes.size() && (opponent == search.player || !state.snakes[opponent].alive))
+    ++opponent;
+
+  if(opponent == (int)state.snakes.size()){
+    ++search.nodes;
+    int result = snakeMakeTick(state, search.input, search.undo[ply]);
+    int score;
+    /* Sooner wins and later losses are better. Everybody dying at once is a draw. */
+    if(result == 0) score = 0;
+    else if(!state.snakes[search.player].alive) score = -SEARCH_WIN + ply;
+    else if(result == search.player + 1) score = SEARCH_WIN - ply;
+    else score = searchTick(search, ply + 1, depth - 1, alpha, beta);
+    snakeUnmakeTick(state, search.undo[ply]);
+    return score;
+  }
+
+  Direction moves[4];
+  int moveCount = generateMoves(state, opponent, -1, moves);
+  int best = SEARCH_WIN + 1;
+  for(int i = 0; i < moveCount; ++i){
+    search.input[opponent] = moves[i];
+    int score = searchOpponents(search, opponent + 1, ply, depth, alpha, beta);
+    if(search.aborted) return 0;
+    if(score < best) best = score;
+    if(best < beta) beta = best;
+    if(best <= alpha) break;
+  }
+  return best;
+}
+
+/* Our move at the start of a tick. depth counts the ticks left to search. */
+static int searchTick(Search& search, int ply, int depth, int alpha, int beta)
+{
+  if(outOfTime(search)) return 0;
+  if(depth == 0){
+    ++search.nodes;
+    return evaluate(search);
+  }
+
+  SnakeGameInfo& state = search.state;
+  SnakeTranspositionEntry entry;
+  int firstMove = -1;
+  if(snakeTranspositionProbe(search.table, state.hash, entry)){
+    int score = scoreFromTable(entry.score, ply);
+    if(entry.depth >= depth){
+      if(entry.bound == SnakeBoundExact) return score;
+      if(entry.bound == SnakeBoundLower && score >= beta) return score;
+      if(entry.bound == SnakeBoundUpper && score <= alpha) return score;
+    }
+    firstMove = entry.move;
+  }
+
+  Direction moves[4];
+  int moveCount = generateMoves(state, search.player, firstMove, moves);
+  int originalAlpha = alpha;
+  int best = -SEARCH_WIN - 1;
+  Direction bestMove = moves[0];
+  for(int i = 0; i < moveCount; ++i){
+    search.input[search.player] = moves[i];
+    int score = searchOpponents(search, 0, ply, depth, alpha, beta);
+    if(search.aborted) return 0;
+    if(score > best){
+      best = score;
+      bestMove = moves[i];
+    }
+    if(best > alpha) alpha = best;
+    if(best >= beta) break;
+  }
+
+  entry.score = scoreToTable(best, ply);
+  entry.depth = depth;
+  entry.bound = best <= originalAlpha ? SnakeBoundUpper : (best >= beta ? SnakeBoundLower : SnakeBoundExact);
+  entry.move = bestMove;
+  snakeTranspositionStore(search.table, state.hash, entry);
+  return best;
+}
+
+static void releaseSearch(void* data)
+{
+  delete (Search*)data;
+}
+
+Direction AIMove(int player, const SnakeGameInfo& state, SnakeAIContext& ai)
+{
+  long long start = nowNs();
+  /* The table, the undo stack and the territory buffers are kept for the whole game, so
+     a move neither allocates nor clears them, and the next move starts out knowing
+     what this one found */
+  if(!ai.data){
+    Search* created = new Search;
+    created->undo.resize(SEARCH_MAX_DEPTH);
+    snakeTranspositionInit(created->table, 16);
+    ai.data = created;
+    ai.release = releaseSearch;
+  }
+  Search& search = *(Search*)ai.data;
+  snakeTranspositionNewSearch(search.table);
+  search.state = state;
+  /* Food placed during the search comes from our own generator */
+  search.state.rng = ai.rng;
+  snakeRandomNext(ai.rng);
+  search.player = player;
+  search.input.assign(state.snakes.size(), Up);
+  search.deadline = start + moveBudgetMs() * 1000000LL;
+  search.nodeBudget = moveBudgetNodes();
+  search.nodes = 0;
+  search.clockCountdown = SEARCH_CLOCK_INTERVAL;
+  search.aborted = false;
+
+  /* Good enough to play if not even depth 1 finishes */
+  Direction moves[4];
+  generateMoves(search.state, player, -1, moves);
+  Direction bestMove = moves[0];
+  int completedDepth = 0;
+  for(int depth = 1; depth <= SEARCH_MAX_DEPTH; ++depth){
+    int score = searchTick(search, 0, depth, -SEARCH_WIN - 1, SEARCH_WIN + 1);
+    if(search.aborted) break;
+    /* Paranoid opponents can always find a way to kill us eventually. The move that
+       looked best one depth earlier has a better chance against real ones. */
+    if(score <= -SEARCH_WIN + SEARCH_MAX_DEPTH && completedDepth > 0) break;
+    SnakeTranspositionEntry entry;
+    if(snakeTranspositionProbe(search.table, search.state.hash, entry))
+      bestMove = (Direction)entry.move;
+    completedDepth = depth;
+    /* Nothing left to find once the outcome is certain */
+    if(score >= SEARCH_WIN - SEARCH_MAX_DEPTH || score <= -SEARCH_WIN + SEARCH_MAX_DEPTH) break;
+  }
+  return bestMove;
+}
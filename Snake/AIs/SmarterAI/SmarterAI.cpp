@@ -1,10 +1,10 @@
 #include <algorithm>
 #include <iterator>
-#include <stack>
 #include <cstdio>
 #include <cmath>
 #include <iostream>
 #include "../../shared/SnakeGame.hpp"
+#include "../../shared/SnakeBitboard.hpp"
 
 
 /*
@@ -31,86 +31,51 @@ std::string directionToString(Direction d)
   }
 }
 
-Point getCurrentHead(const SnakeGameInfo& state)
-{
-  return state.snakes[state.currentPlayer].bodyParts[0];
-}
-
 Point getHead(const SnakeGameInfo& state, int playerID)
 {
   return state.snakes[playerID].bodyParts[0];
 }
 
-int getCurrentSnakeLength(const SnakeGameInfo& state)
-{
-  return state.snakes[state.currentPlayer].bodyParts.size();
-}
-
 int getSnakeLength(const SnakeGameInfo& state, int playerID)
 {
   return state.snakes[playerID].bodyParts.size();
 }
 
 
-int generateCoverageMap(const SnakeGameInfo& state, std::vector<int>& level, std::vector<Point> potentialEnemyHeads)
+/* Marks the cells we can move through in openCells: no walls, no snakes, and none of the
+   potential enemy heads. Returns the total number of such cells on the level. */
+int generateCoverageMap(const SnakeGameInfo& state, SnakeBitboard& openCells, const std::vector<Point>& potentialEnemyHeads)
 {
   int width = state.levelWidth;
   int height = state.levelHeight;
-  /* Return the total number of empty space on the level */
-  int initialCoverage = 0;
 
-  level.resize(width * height);
+  snakeBitboardInit(openCells, width, height);
   for(int y = 0; y < height; ++y){
     for(int x = 0; x < width; ++x){
-      bool inPEH = false;
-      for(int i = 0; i < potentialEnemyHeads.size(); ++i){
-	if(potentialEnemyHeads[i] == Point(x,y)){
-	  inPEH = true;
-	  break;
-	}
-      }
-      if(snakeIsCellBorder(x, y, state.level) ||
-	 snakeIsCellSnake(x, y, -1, state.snakes) ||
-	 inPEH)
-	level[x + y * width] = 1;
-      else {
-	level[x + y * width] = 0;
-	++initialCoverage;
-      }
+      if(!snakeIsCellBorder(x, y, state.level) && !snakeIsCellSnake(x, y, -1, state))
+	snakeBitboardSet(openCells, x, y);
     }
   }
-  return initialCoverage;
+  for(int i = 0; i < potentialEnemyHeads.size(); ++i){
+    Point p = potentialEnemyHeads[i];
+    if(snakeBitboardTest(openCells, p.x, p.y))
+      snakeBitboardReset(openCells, p.x, p.y);
+  }
+  return snakeBitboardCount(openCells);
 }
 
-int getCoverageScore(const SnakeGameInfo& state, std::vector<int> coverageMap, Point head)
+/* The available "area" if we move to [head.x head.y]. scratch holds the flood fill. */
+int getCoverageScore(const SnakeBitboard& openCells, Point head, SnakeBitboard& scratch)
 {
-  int coverageCount = 0;
-  std::stack<Point> st;
-  
-  /* Flood fill to find available "area" if we move to [head.x head.y]*/
-  st.push(head);
-  while(!st.empty()){
-    Point p = st.top();
-    st.pop();
-    int index = p.x + p.y * state.levelWidth;
-    if(coverageMap[index] == 0){
-      coverageMap[index] = 1;
-      ++coverageCount;
-      st.push(Point(p.x + 1, p.y));
-      st.push(Point(p.x - 1, p.y));
-      st.push(Point(p.x    , p.y - 1));
-      st.push(Point(p.x    , p.y + 1));
-    }
-  }
-  return coverageCount;
+  return snakeBitboardFloodFill(openCells, head.x, head.y, scratch);
 }
 
 /* The available positions ("potential" heads) for the enemy snakes.
    We want to avoid these positions because we might collide there at the next turn. */
-void getPotentialEnemyPositions(const SnakeGameInfo& state, std::vector<Point>& pheads)
+void getPotentialEnemyPositions(const SnakeGameInfo& state, int player, std::vector<Point>& pheads)
 {
   for(int eachSnake = 0; eachSnake < state.playerCount; ++eachSnake){
-    if(eachSnake == state.currentPlayer) continue;
+    if(eachSnake == player) continue;
     Point head = getHead(state, eachSnake);
     /* One of these are redundant if the snake length is greater than 1, but it doesn't matter */
     pheads.push_back(snakeComputeNewHead(head, Up));
@@ -120,19 +85,19 @@ void getPotentialEnemyPositions(const SnakeGameInfo& state, std::vector<Point>&
   }
 }
 
-void RemoveSuicideMoves(const SnakeGameInfo& state, std::vector<Direction>& potentialMoves,
-			const std::vector<int>& coverageMap)
+void RemoveSuicideMoves(const SnakeGameInfo& state, int player, std::vector<Direction>& potentialMoves,
+			const int moveCoverage[4])
 {
   std::vector<Direction> suicideMoves;
   std::vector<Direction> result;
   for(int i = 0; i < potentialMoves.size(); ++i){
-    Point head = getCurrentHead(state);
+    Point head = getHead(state, player);
     Point newhead = snakeComputeNewHead(head, potentialMoves[i]);
-    int sampleCount = getCoverageScore(state, coverageMap, newhead);
+    int sampleCount = moveCoverage[potentialMoves[i]];
     /* If sampleCount is less than the snake length, then there isn't space for the whole snake. */
-    bool pathIsEvilSpiralOfDeath = sampleCount < getCurrentSnakeLength(state);
+    bool pathIsEvilSpiralOfDeath = sampleCount < getSnakeLength(state, player);
     bool pathCollidesWithBorder = snakeIsCellBorder(newhead.x, newhead.y, state.level);
-    bool pathCollidesWithSnake = snakeIsCellSnake(newhead.x, newhead.y, -1, state.snakes);
+    bool pathCollidesWithSnake = snakeIsCellSnake(newhead.x, newhead.y, -1, state);
     if(pathIsEvilSpiralOfDeath || pathCollidesWithBorder || pathCollidesWithSnake)
       suicideMoves.push_back(potentialMoves[i]);      
   }
@@ -142,10 +107,10 @@ void RemoveSuicideMoves(const SnakeGameInfo& state, std::vector<Direction>& pote
   potentialMoves = result;
 }
 
-void computePreferredFoodMoves(SnakeGameInfo& state, std::vector<Direction>& preferredFoodMoves)
+void computePreferredFoodMoves(const SnakeGameInfo& state, int player, std::vector<Direction>& preferredFoodMoves)
 {
   Point head, foodDelta;
-  head = getCurrentHead(state);
+  head = getHead(state, player);
   foodDelta.x = state.foodPosition.x - head.x;
   foodDelta.y = state.foodPosition.y - head.y;
 
@@ -170,9 +135,20 @@ struct MoveWithScore
   int score;
 };
 
-Direction AIMove(int player, SnakeGameInfo& state)
+/* The bitboards are kept in SnakeAIContext::data for the whole game, so a move doesn't allocate them */
+struct CoverageBuffers
+{
+  SnakeBitboard coverageMap;
+  SnakeBitboard scratch;
+};
+
+static void releaseCoverageBuffers(void* data)
+{
+  delete (CoverageBuffers*)data;
+}
+
+Direction AIMove(int player, const SnakeGameInfo& state, SnakeAIContext& ai)
 {
-  Direction d;
   int totalCoverage = 0;
   
   std::vector<Direction> startMoves;
@@ -180,8 +156,13 @@ Direction AIMove(int player, SnakeGameInfo& state)
   std::vector<Direction> potentialMoves;
   std::vector<MoveWithScore> potentialMovesWithScore;
   std::vector<Point> potentialEnemyHeads;
-  std::vector<int> coverageMap;
-  std::vector<int> potentialMoveScores;
+  int moveCoverage[4];
+  if(!ai.data){
+    ai.data = new CoverageBuffers;
+    ai.release = releaseCoverageBuffers;
+  }
+  SnakeBitboard& coverageMap = ((CoverageBuffers*)ai.data)->coverageMap;
+  SnakeBitboard& scratch = ((CoverageBuffers*)ai.data)->scratch;
   startMoves.push_back(Up);
   startMoves.push_back(Down);
   startMoves.push_back(Left);
@@ -189,13 +170,17 @@ Direction AIMove(int player, SnakeGameInfo& state)
   potentialMoves = startMoves;
 
   /* An array of moves that leads us closer to the food */
-  computePreferredFoodMoves(state, preferredFoodMoves);
+  computePreferredFoodMoves(state, player, preferredFoodMoves);
   /* An array of points which represents all the possible enemy positions we should avoid */
-  getPotentialEnemyPositions(state, potentialEnemyHeads);
+  getPotentialEnemyPositions(state, player, potentialEnemyHeads);
   /* Compute coverage map and the total count of free level space */
   totalCoverage = generateCoverageMap(state, coverageMap, potentialEnemyHeads);
+  /* The coverage of every move is needed twice below, so flood fill once per move */
+  for(int i = 0; i < (int)startMoves.size(); ++i)
+    moveCoverage[startMoves[i]] = getCoverageScore(coverageMap, snakeComputeNewHead(getHead(state, player), startMoves[i]),
+						   scratch);
   /* Remove all moves that leads to suicide */
-  RemoveSuicideMoves(state, potentialMoves, coverageMap);
+  RemoveSuicideMoves(state, player, potentialMoves, moveCoverage);
   
   /* potentialMoves now contains moves that doesn't 100% surely kill us.
      What to do next? Based on the remainding moves, compute a score based on:
@@ -210,17 +195,17 @@ Direction AIMove(int player, SnakeGameInfo& state)
 
   for(int i = 0; i < (int)potentialMovesWithScore.size(); ++i){
     Point head, newhead;
-    head = getCurrentHead(state);
+    head = getHead(state, player);
     newhead = snakeComputeNewHead(head, potentialMovesWithScore[i].direction);
     for(int j = 0; j < potentialEnemyHeads.size(); ++j){
       if(potentialEnemyHeads[j] == newhead)
 	potentialMovesWithScore[i].score -= 20;
     }
-    int coverage = getCoverageScore(state, coverageMap, newhead);
+    int coverage = moveCoverage[potentialMovesWithScore[i].direction];
     int coverageScore = std::floor((float)coverage / (float)totalCoverage * 18.0f);
     if(coverage < totalCoverage){
       fprintf(stderr, "[Player %d] direction %s coverage %d / %d\n",
-	    state.currentPlayer, directionToString(potentialMovesWithScore[i].direction).c_str(),
+	    player, directionToString(potentialMovesWithScore[i].direction).c_str(),
 	    coverage, totalCoverage);
       fflush(stderr);
     }
@@ -235,10 +220,10 @@ Direction AIMove(int player, SnakeGameInfo& state)
   it = std::max_element(potentialMovesWithScore.begin(), potentialMovesWithScore.end());
 
   /* Debug info */
-  //fprintf(stderr, "[Player %d] Potential directions / scores:\n", state.currentPlayer);
+  //fprintf(stderr, "[Player %d] Potential directions / scores:\n", player);
   for(int i = 0; i < potentialMovesWithScore.size(); ++i){
     fprintf(stderr, "[Player %d] %s : %d\n",
-	    state.currentPlayer,
+	    player,
 	    directionToString(potentialMovesWithScore[i].direction).c_str(),
 	    potentialMovesWithScore[i].score);
     fflush(stderr);
@@ -247,36 +232,3 @@ Direction AIMove(int player, SnakeGameInfo& state)
     return it->direction;
   else return Up;
 }
-
-void readGameState(SnakeGameInfo& state)
-{
-  std::vector<std::string> strm;
-  std::string line;
-  char szbuf[512];
-  
-  while(std::getline(std::cin, line)){
-    if(line == "END") break;
-    strm.push_back(line);
-  };
-  
-  snakeSerializeStreamToState(state, strm);
-}
-
-int main(int argc, char* argv[])
-{
-  SnakeGameInfo state;
-  Direction d;
-  readGameState(state);
-  while(state.snakes[state.currentPlayer].alive){
-    d = AIMove(state.currentPlayer, state);
-    switch(d){
-    case Up: std::cout << 'u'; break;
-    case Down: std::cout << 'd'; break;
-    case Left: std::cout << 'l'; break;
-    default: std::cout << 'r'; break;
-    }
-    std::cout.flush();
-    readGameState(state);
-  }
-  return 0;
-}
@@ -1,10 +1,19 @@
-#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include "../../shared/SnakeGame.hpp"
 
+/* Fisher-Yates, with our own generator so the AI plays the same way for the same seed */
+static void shuffleMoves(std::vector<Direction>& moves, SnakeRandom& rng)
+{
+  for(int i = (int)moves.size() - 1; i > 0; --i){
+    int j = randRange(rng, 0, i);
+    Direction tmp = moves[i];
+    moves[i] = moves[j];
+    moves[j] = tmp;
+  }
+}
 
-Direction AIMove(int player, SnakeGameInfo& state)
+Direction AIMove(int player, const SnakeGameInfo& state, SnakeAIContext& ai)
 {
   Point head, newHead, foodDelta;
   const Direction startMoves[4] = { Up, Down, Left, Right };
@@ -28,11 +37,11 @@ Direction AIMove(int player, SnakeGameInfo& state)
 
   /* Try to get closer to the food first */
   if(!possibleMoves.empty()){
-    std::random_shuffle(possibleMoves.begin(), possibleMoves.end());
+    shuffleMoves(possibleMoves, ai.rng);
     for(int i=0; i<possibleMoves.size(); ++i){
       newHead = snakeComputeNewHead(head, possibleMoves[i]);
       bool collideWithBorder = snakeIsCellBorder(newHead.x, newHead.y, state.level);
-      bool collideWithSnake = snakeIsCellSnake(newHead.x, newHead.y, -1, state.snakes);
+      bool collideWithSnake = snakeIsCellSnake(newHead.x, newHead.y, -1, state);
       if(!collideWithBorder && !collideWithSnake){
 	return possibleMoves[i];
       }
@@ -44,48 +53,15 @@ Direction AIMove(int player, SnakeGameInfo& state)
   for(int i = 0; i < 4; ++i){
     newHead = snakeComputeNewHead(head, startMoves[i]);
     bool collideWithBorder = snakeIsCellBorder(newHead.x, newHead.y, state.level);
-    bool collideWithSnake = snakeIsCellSnake(newHead.x, newHead.y, -1, state.snakes);
+    bool collideWithSnake = snakeIsCellSnake(newHead.x, newHead.y, -1, state);
     /* If cell is free of walls and snakes, it is a possible move */
     if(!collideWithBorder && !collideWithSnake)
       possibleMoves.push_back(startMoves[i]);
   }
-  std::random_shuffle(possibleMoves.begin(), possibleMoves.end());
+  shuffleMoves(possibleMoves, ai.rng);
   /* If no moves are possible, go up and die */
   if(possibleMoves.empty()) d = Up;
   else d = possibleMoves[0];
 
   return d;
 }
-
-void readGameState(SnakeGameInfo& state)
-{
-  std::vector<std::string> strm;
-  std::string line;
-  char szbuf[512];
-  
-  while(std::getline(std::cin, line)){
-    if(line == "END") break;
-    strm.push_back(line);
-  };
-  
-  snakeSerializeStreamToState(state, strm);
-}
-
-int main(int argc, char* argv[])
-{
-  SnakeGameInfo state;
-  Direction d;
-  readGameState(state);
-  while(state.snakes[state.currentPlayer].alive){
-    d = AIMove(state.currentPlayer, state);
-    switch(d){
-    case Up: std::cout << 'u'; break;
-    case Down: std::cout << 'd'; break;
-    case Left: std::cout << 'l'; break;
-    default: std::cout << 'r'; break;
-    }
-    std::cout.flush();
-    readGameState(state);
-  }
-  return 0;
-}
@@ -1,129 +1,22 @@
-#include <unistd.h>
 #include <signal.h>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
-#include <boost/array.hpp>
-#include <SDL/SDL.h>
+#include <time.h>
 #include "shared/SnakeGame.hpp"
+#include "SnakeIPC.hpp"
+#include "SnakeStats.hpp"
+#include "SnakeReplay.hpp"
+#include "SnakeViewer.hpp"
 
-typedef boost::array<FILE*, 2> pipearr_t;
-struct childproc_t
+/* Sleeps until the monotonic clock reaches ns, see stats_now_ns */
+static void wait_until(long long ns)
 {
-  pid_t pid;
-  std::string path;
-};
-
-static bool init_ipc(std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms, int numProcesses)
-{
-  /*
-    parent reads strms[i][0], child writes strms[i][1]
-    child reads pipeChild[0], parent writes pipeChild[1];
-  */
-  strms.resize(numProcesses);
-  int pipeParent[2];
-  int pipeChild[2];
-
-  for(int i=0; i < numProcesses; ++i){
-    (void)pipe(pipeParent);
-    (void)pipe(pipeChild);
-
-    pid_t p = fork();
-    switch(p){
-      case -1:
-      {
-	/* Close previous */
-	for(int j=0; j < i; ++j){
-	  fclose(strms[j][0]);
-	  fclose(strms[j][1]);
-	}
-	/* Close current */
-	close(pipeParent[0]);
-	close(pipeParent[1]);
-	close(pipeChild[0]);
-	close(pipeChild[1]);
-	/* Kill'em all! */
-	for(int j=0; j < i; ++j)
-	  kill(procList[i].pid, 2);
-	return false;
-      }
-      /* Inside the child process.
-	 We start off by closing all the pipes we don't need,
-	 then we duplicate the pipe we're going to use to represent
-	 stdin and stdout. Finally we start the inferior process with execve. */
-      case 0:
-      {
-	for(int j=0; j < i; ++j){
-	  fclose(strms[j][0]);
-	  fclose(strms[j][1]);
-	}
-	/* Close write-end */
-	close(pipeChild[1]);
-	/* close read-end */
-	close(pipeParent[0]);
-
-	dup2(pipeChild[0], STDIN_FILENO);
-	dup2(pipeParent[1], STDOUT_FILENO);
-	close(pipeChild[0]);
-	close(pipeParent[1]);
-	char* argv[1] = {NULL};
-	if(execve(procList[i].path.c_str(), argv, NULL) < 0) exit(1);
-      }
-      default:
-      {
-	procList[i].pid = p;
-	/* close read-end */
-	close(pipeChild[0]);	  
-	/* Close write-end */
-	close(pipeParent[1]);
-	/* Convert to FILE handles */
-	strms[i][0] = fdopen(pipeParent[0], "r");
-	strms[i][1] = fdopen(pipeChild[1], "w");
-      }
-    }
-  }
-  return true;
-}
-
-static void destroy_ipc(std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms, int numProcesses)
-{
-  for(int i=0; i < numProcesses; ++i){
-    fclose(strms[i][0]);
-    fclose(strms[i][1]);
-    kill(procList[i].pid, 2);
-  }
-}
-
-static void send_ipc(SnakeGameInfo& state, std::vector<pipearr_t>& strms)
-{
-  std::string strm_state;
-  for(int i=0; i < (int)strms.size(); ++i){
-    state.currentPlayer = i;
-    snakeSerializeStateToStream(state, strm_state); 
-    if(!state.snakes[i].alive) continue;
-    fprintf(strms[i][1], "%s", strm_state.c_str());
-    fprintf(strms[i][1], "END\n");
-    fflush(strms[i][1]);
-  }
-}
-
-static void recv_ipc(const SnakeGameInfo& state, std::vector<Direction>& inputs, std::vector<pipearr_t>& strms)
-{
-  char ch;
-  Direction d;
-  for(int i=0; i < (int)strms.size(); ++i){
-    if(!state.snakes[i].alive) continue;
-    (void)fscanf(strms[i][0], "%c", &ch);
-    switch(ch){
-      case 'u' : d = Up; break;
-      case 'd' : d = Down; break;
-      case 'l' : d = Left; break;
-      case 'r' : d = Right; break;
-      default: d = IllegalDirection;
-    }
-    inputs[i] = d;
-  }
+  struct timespec ts;
+  ts.tv_sec = ns / 1000000000LL;
+  ts.tv_nsec = ns % 1000000000LL;
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0){}
 }
 
 int main(int argc, char* argv[])
@@ -133,15 +26,21 @@ int main(int argc, char* argv[])
   std::vector<Direction> playerInputs;
   std::vector<childproc_t> procList;
   std::vector<pipearr_t> strms;
+  shmtransport_t shm;
+  sendbuffers_t sendBuffers;
+  snakeoptions_t options;
+  matchstats_t stats;
+  replaywriter_t replay;
+  viewer_t viewer;
 
-  srand(time(NULL));
-  
+  /* An AI that exits early must not take the whole controller down with it */
+  signal(SIGPIPE, SIG_IGN);
 
-  if(argc < 4){
-    printf("Usage: %s <levelFile> <AIprog1> ... <AIprogN>\n", argv[0]);
+  if(!parse_options(argc, argv, options)){
+    print_usage(argv[0]);
     return 0;
   }
-  numPlayers = argc - 2;
+  numPlayers = options.aiPaths.size();
   /* You can really add as many players as you want, but first
      you have to increase the size of the "color" array in void snakeRender(SnakeGameInfo& state)
      which is in SnakeRenderer.cpp */
@@ -150,41 +49,89 @@ int main(int argc, char* argv[])
   }
   procList.resize(numPlayers);
   playerInputs.resize(numPlayers);
-  for(int i = 0; i < numPlayers; ++i)
-    procList[i].path = std::string(argv[i+2]);
-  if(!init_ipc(procList, strms, numPlayers)){
-    printf("Error spawning processes.\n");
-    return 0;
+  for(int i = 0; i < numPlayers; ++i){
+    procList[i].path = options.aiPaths[i];
+    procList[i].seed = snakePlayerSeed(options.seed, i);
+    procList[i].deadlineMs = options.deadlineMs;
   }
 
-  if(!snakeInitLevel(std::string(argv[1]), state)){
-    printf("Couldn't open level \"%s\"\n", argv[1]);
+  if(!snakeInitLevel(options.levelFile, state)){
+    printf("Couldn't open level \"%s\"\n", options.levelFile.c_str());
     return 0;
   }
+  snakeSeedRandom(state.rng, options.seed);
+  printf("Seed %llu\n", (unsigned long long)options.seed);
   snakeInitSnakes(state, numPlayers);
   snakeInitFood(state);
+  /* The shared memory region is sized after the level, so set it up before spawning the AIs */
+  init_shm(state, shm);
+  if(!init_ipc(procList, strms, numPlayers, shm)){
+    printf("Error spawning processes.\n");
+    return 0;
+  }
   /* Important. Call snakeInitSnakes before setting up the graphics, to set the number of players.
      Maybe merge snakeInitLevel, snakeInitSnakes and snakeInitFood into a single snakeInit function? */
-  if(!snakeInitGraphics(state)){
+  state.vs = NULL;
+  if(!viewer_start(viewer, state, options.renderEvery)){
     printf("Unable to set video mode.\n");
     return 0;
   }
   
   int winner;
+  int tickCount = 0;
+  /* 0 runs the ticks back to back */
+  long long tickPeriod = options.speed > 0 ? SNAKE_TICK_MS * 1000000LL / options.speed : 0;
+  long long nextTick = stats_now_ns();
 
+  if(!options.replayFile.empty() && !replay_open(replay, options.replayFile, state, options.aiPaths, options.seed))
+    printf("Couldn't write replay to \"%s\"\n", options.replayFile.c_str());
+  /* The tick is pipelined: as soon as a state is sent, the AIs think about it while we
+     draw it and do the bookkeeping (stats, replay) of the tick before. Only the game tick itself
+     and the wait for real time sit between getting the moves and sending the next state; the
+     wait comes before sending, so it doesn't eat into the AIs' deadline. */
+  stats_init(stats, numPlayers);
+  send_ipc(state, procList, strms, shm, sendBuffers);
+  stats_lap(stats, PhaseSend);
   do {
-    snakeRender(state);
-    send_ipc(state, strms);
-    recv_ipc(state, playerInputs, strms);
-  } while((winner = snakeGameTick(state, playerInputs)) < 0 && !snakeShouldQuit());  
+    stats_begin(stats);
+    viewer_publish(viewer, state, tickCount, false);
+    if(tickCount > 0){
+      stats_record_latencies(stats, procList);
+      replay_record(replay, playerInputs, state);
+    }
+    stats_lap(stats, PhaseRender);
+    recv_ipc(state, playerInputs, procList, strms, shm, options);
+    stats_lap(stats, PhaseRecv);
+    winner = snakeGameTick(state, playerInputs);
+    stats_lap(stats, PhaseTick);
+    ++tickCount;
+    if(winner < 0 && !viewer_should_quit(viewer)){
+      if(tickPeriod > 0){
+	nextTick += tickPeriod;
+	/* A tick that ran late doesn't make the next ones short */
+	if(nextTick < stats_now_ns()) nextTick = stats_now_ns();
+	else wait_until(nextTick);
+	stats_begin(stats);
+      }
+      send_ipc(state, procList, strms, shm, sendBuffers);
+      stats_lap(stats, PhaseSend);
+    }
+  } while(winner < 0 && !viewer_should_quit(viewer));
+  stats_record_latencies(stats, procList);
+  replay_record(replay, playerInputs, state);
+  if(!replay_close(replay, winner))
+    printf("Couldn't write replay to \"%s\"\n", options.replayFile.c_str());
+  viewer_publish(viewer, state, tickCount, true);
+  if(!options.statsFile.empty() && !stats_write_json(stats, options.statsFile, procList, tickCount, winner, options.seed))
+    printf("Couldn't write stats to \"%s\"\n", options.statsFile.c_str());
   destroy_ipc(procList, strms, numPlayers);
+  destroy_shm(shm);
   if(!winner)
     printf("Game ended in a draw.\n");
   else {
     printf("Player %d wins!\n", winner);
   }
 
-  while(!snakeShouldQuit()){}
-  snakeDestroyGraphics();
+  viewer_finish(viewer);
   return 0;
 }
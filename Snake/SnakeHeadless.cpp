@@ -0,0 +1,97 @@
+#include <signal.h>
+#include <cstdio>
+#include <cstdlib>
+#include "shared/SnakeGame.hpp"
+#include "SnakeIPC.hpp"
+#include "SnakeStats.hpp"
+#include "SnakeReplay.hpp"
+
+/*
+  Headless match runner. Same game loop as the Snake controller, but without
+  any rendering, frame delay or SDL dependency. Ticks run as fast as the AIs answer.
+*/
+
+int main(int argc, char* argv[])
+{
+  int numPlayers;
+  int tickCount = 0;
+  int winner;
+  SnakeGameInfo state;
+  std::vector<Direction> playerInputs;
+  std::vector<childproc_t> procList;
+  std::vector<pipearr_t> strms;
+  shmtransport_t shm;
+  sendbuffers_t sendBuffers;
+  snakeoptions_t options;
+  matchstats_t stats;
+  replaywriter_t replay;
+
+  /* An AI that exits early must not take the whole runner down with it */
+  signal(SIGPIPE, SIG_IGN);
+
+  if(!parse_options(argc, argv, options)){
+    print_usage(argv[0]);
+    return 0;
+  }
+  numPlayers = options.aiPaths.size();
+  procList.resize(numPlayers);
+  playerInputs.resize(numPlayers);
+  for(int i = 0; i < numPlayers; ++i){
+    procList[i].path = options.aiPaths[i];
+    procList[i].seed = snakePlayerSeed(options.seed, i);
+    procList[i].deadlineMs = options.deadlineMs;
+  }
+  if(!snakeInitLevel(options.levelFile, state)){
+    printf("Couldn't open level \"%s\"\n", options.levelFile.c_str());
+    return 1;
+  }
+  snakeSeedRandom(state.rng, options.seed);
+  printf("Seed %llu\n", (unsigned long long)options.seed);
+  snakeInitSnakes(state, numPlayers);
+  snakeInitFood(state);
+  state.vs = NULL;
+  /* The shared memory region is sized after the level, so set it up before spawning the AIs */
+  init_shm(state, shm);
+  if(!init_ipc(procList, strms, numPlayers, shm)){
+    printf("Error spawning processes.\n");
+    return 1;
+  }
+
+  if(!options.replayFile.empty() && !replay_open(replay, options.replayFile, state, options.aiPaths, options.seed))
+    printf("Couldn't write replay to \"%s\"\n", options.replayFile.c_str());
+  /* Pipelined like in SnakeController.cpp: the stats and the replay of a tick
+     are recorded while the AIs think about the next state */
+  stats_init(stats, numPlayers);
+  send_ipc(state, procList, strms, shm, sendBuffers);
+  stats_lap(stats, PhaseSend);
+  do {
+    stats_begin(stats);
+    if(tickCount > 0){
+      stats_record_latencies(stats, procList);
+      replay_record(replay, playerInputs, state);
+    }
+    recv_ipc(state, playerInputs, procList, strms, shm, options);
+    stats_lap(stats, PhaseRecv);
+    winner = snakeGameTick(state, playerInputs);
+    stats_lap(stats, PhaseTick);
+    ++tickCount;
+    if(winner < 0){
+      send_ipc(state, procList, strms, shm, sendBuffers);
+      stats_lap(stats, PhaseSend);
+    }
+  } while(winner < 0);
+  stats_record_latencies(stats, procList);
+  replay_record(replay, playerInputs, state);
+  if(!replay_close(replay, winner))
+    printf("Couldn't write replay to \"%s\"\n", options.replayFile.c_str());
+  if(!options.statsFile.empty() && !stats_write_json(stats, options.statsFile, procList, tickCount, winner, options.seed))
+    printf("Couldn't write stats to \"%s\"\n", options.statsFile.c_str());
+  destroy_ipc(procList, strms, numPlayers);
+  destroy_shm(shm);
+
+  if(!winner)
+    printf("Game ended in a draw after %d ticks.\n", tickCount);
+  else
+    printf("Player %d wins after %d ticks.\n", winner, tickCount);
+  return 0;
+}
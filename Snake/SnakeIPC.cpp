@@ -0,0 +1,564 @@
+#include <unistd.h>
+#include <signal.h>
+#include <stdint.h>
+#include <poll.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include "SnakeIPC.hpp"
+#include "SnakeStats.hpp"
+
+/* Creates a memfd of the given size and maps it read-write, then adds the seals. The fd
+   is close-on-exec, init_ipc hands it on only to the AI that is meant to have it.
+   Returns -1 on failure. */
+static int create_shared(const char* name, long size, int seals, void*& mapping)
+{
+  int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if(fd < 0) return -1;
+  if(ftruncate(fd, size) < 0){
+    close(fd);
+    return -1;
+  }
+  mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(mapping == MAP_FAILED){
+    close(fd);
+    return -1;
+  }
+  if(fcntl(fd, F_ADD_SEALS, seals) < 0){
+    munmap(mapping, size);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Sets up the shared memory for a match. Must be called after the level and the snakes
+   are initialized, since its size depends on them. On failure the shared memory
+   transport simply isn't offered to the AIs.
+
+   Every AI gets the state memfd, sealed so that nobody can map it writable or resize it
+   any more; only the controller's own mapping from before the seal can write it. The move
+   slots are a memfd per player, so an AI can't get at anybody else's. They can't be
+   resized either, which would make the controller fault on reading them. */
+bool init_shm(const SnakeGameInfo& state, shmtransport_t& shm)
+{
+  void* mapping;
+
+  shm.memfd = -1;
+  shm.base = NULL;
+  shm.tick = 0;
+  shm.slotfds.clear();
+  shm.slots.clear();
+  shm.pageSize = sysconf(_SC_PAGESIZE);
+  shm.size = SNAKE_SHM_STATE_DATA_OFFSET + snakeBinaryMaxMessageLength(state);
+  shm.size = (shm.size + shm.pageSize - 1) / shm.pageSize * shm.pageSize;
+
+  for(int i = 0; i < state.playerCount; ++i){
+    int fd = create_shared("snake-slot", shm.pageSize, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL, mapping);
+    if(fd < 0){
+      destroy_shm(shm);
+      return false;
+    }
+    shm.slotfds.push_back(fd);
+    shm.slots.push_back((SnakeShmSlot*)mapping);
+  }
+  int fd = create_shared("snake-state", shm.size,
+			 F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL, mapping);
+  if(fd < 0){
+    destroy_shm(shm);
+    return false;
+  }
+  shm.memfd = fd;
+  shm.base = (unsigned char*)mapping;
+  return true;
+}
+
+void destroy_shm(shmtransport_t& shm)
+{
+  for(size_t i = 0; i < shm.slotfds.size(); ++i){
+    munmap(shm.slots[i], shm.pageSize);
+    close(shm.slotfds[i]);
+  }
+  shm.slotfds.clear();
+  shm.slots.clear();
+  if(shm.memfd < 0) return;
+  munmap(shm.base, shm.size);
+  close(shm.memfd);
+  shm.memfd = -1;
+}
+
+static SnakeShmSlot* shm_slot(const shmtransport_t& shm, int player)
+{
+  return shm.slots[player];
+}
+
+static void close_doorbells(childproc_t& proc)
+{
+  if(proc.tickfd >= 0) close(proc.tickfd);
+  if(proc.movefd >= 0) close(proc.movefd);
+  proc.tickfd = -1;
+  proc.movefd = -1;
+}
+
+static bool is_plugin_path(const std::string& path)
+{
+  return path.size() > 3 && path.compare(path.size() - 3, 3, ".so") == 0;
+}
+
+/* Loads an AI shared object. On failure the AI stays in the game without a plugin,
+   and loses on its first move like an AI program that can't be started. */
+static void load_plugin(childproc_t& proc, int player)
+{
+  proc.pluginContext = NULL;
+  if(open_plugin(proc.path, proc.plugin))
+    proc.pluginContext = proc.plugin.api->init(player, proc.seed);
+}
+
+static void unload_plugin(childproc_t& proc)
+{
+  if(proc.pluginContext) proc.plugin.api->shutdown(proc.pluginContext);
+  close_plugin(proc.plugin);
+  proc.pluginContext = NULL;
+}
+
+bool init_ipc(std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms, int numProcesses,
+	      const shmtransport_t& shm)
+{
+  /*
+    parent reads strms[i][0], child writes strms[i][1]
+    child reads pipeChild[0], parent writes pipeChild[1];
+  */
+  strms.resize(numProcesses);
+  int pipeParent[2];
+  int pipeChild[2];
+
+  for(int i=0; i < numProcesses; ++i){
+    procList[i].plugin.handle = NULL;
+    procList[i].pluginContext = NULL;
+    if(is_plugin_path(procList[i].path)){
+      procList[i].pid = -1;
+      procList[i].protocol = SnakeProtocolPlugin;
+      procList[i].tickfd = -1;
+      procList[i].movefd = -1;
+      procList[i].skipMoves = 0;
+      procList[i].behind = false;
+      strms[i][0] = NULL;
+      strms[i][1] = NULL;
+      load_plugin(procList[i], i);
+      continue;
+    }
+    (void)pipe(pipeParent);
+    (void)pipe(pipeChild);
+    procList[i].tickfd = -1;
+    procList[i].movefd = -1;
+    if(shm.memfd >= 0){
+      procList[i].tickfd = eventfd(0, 0);
+      procList[i].movefd = eventfd(0, 0);
+      if(procList[i].tickfd < 0 || procList[i].movefd < 0)
+	close_doorbells(procList[i]);
+    }
+
+    pid_t p = fork();
+    switch(p){
+      case -1:
+      {
+	/* Close previous */
+	for(int j=0; j < i; ++j){
+	  if(procList[j].protocol == SnakeProtocolPlugin){
+	    unload_plugin(procList[j]);
+	    continue;
+	  }
+	  fclose(strms[j][0]);
+	  fclose(strms[j][1]);
+	}
+	/* Close current */
+	close_doorbells(procList[i]);
+	close(pipeParent[0]);
+	close(pipeParent[1]);
+	close(pipeChild[0]);
+	close(pipeChild[1]);
+	/* Kill'em all! */
+	for(int j=0; j < i; ++j)
+	  if(procList[j].pid > 0) kill(procList[j].pid, 2);
+	return false;
+      }
+      /* Inside the child process.
+	 We start off by closing all the pipes we don't need,
+	 then we duplicate the pipe we're going to use to represent
+	 stdin and stdout. Finally we start the inferior process with execve. */
+      case 0:
+      {
+	for(int j=0; j < i; ++j){
+	  if(procList[j].protocol == SnakeProtocolPlugin) continue;
+	  fclose(strms[j][0]);
+	  fclose(strms[j][1]);
+	  close_doorbells(procList[j]);
+	}
+	/* Close write-end */
+	close(pipeChild[1]);
+	/* close read-end */
+	close(pipeParent[0]);
+
+	dup2(pipeChild[0], STDIN_FILENO);
+	dup2(pipeParent[1], STDOUT_FILENO);
+	close(pipeChild[0]);
+	close(pipeParent[1]);
+	char* argv[1] = {NULL};
+	char shmEnv[256];
+	char seedEnv[64];
+	char deadlineEnv[64];
+	char nodeBudgetEnv[64];
+	const char* nodeBudget = getenv(SNAKE_NODE_BUDGET_ENV);
+	char* envp[5] = {seedEnv, NULL, NULL, NULL, NULL};
+	int envCount = 1;
+	snprintf(seedEnv, sizeof(seedEnv), "%s=%llu", SNAKE_SEED_ENV, (unsigned long long)procList[i].seed);
+	if(procList[i].deadlineMs > 0){
+	  snprintf(deadlineEnv, sizeof(deadlineEnv), "%s=%d", SNAKE_DEADLINE_ENV, procList[i].deadlineMs);
+	  envp[envCount++] = deadlineEnv;
+	}
+	if(nodeBudget){
+	  snprintf(nodeBudgetEnv, sizeof(nodeBudgetEnv), "%s=%s", SNAKE_NODE_BUDGET_ENV, nodeBudget);
+	  envp[envCount++] = nodeBudgetEnv;
+	}
+	/* Offer the shared memory transport, see shared/SnakeSharedMemory.hpp. The memfds are
+	   close-on-exec, only this AI's own slot and the read-only state are kept open. */
+	if(procList[i].tickfd >= 0){
+	  fcntl(shm.memfd, F_SETFD, 0);
+	  fcntl(shm.slotfds[i], F_SETFD, 0);
+	  snprintf(shmEnv, sizeof(shmEnv), "%s=%d:%d:%d:%d:%d:%ld", SNAKE_SHM_ENV,
+		   shm.memfd, shm.slotfds[i], procList[i].tickfd, procList[i].movefd, i, shm.size);
+	  envp[envCount++] = shmEnv;
+	}
+	if(execve(procList[i].path.c_str(), argv, envp) < 0) exit(1);
+      }
+      default:
+      {
+	procList[i].pid = p;
+	procList[i].protocol = SnakeProtocolText;
+	procList[i].fullStateSent = false;
+	procList[i].skipMoves = 0;
+	procList[i].output.clear();
+	procList[i].behind = false;
+	/* close read-end */
+	close(pipeChild[0]);	  
+	/* Close write-end */
+	close(pipeParent[1]);
+	/* An AI that stops reading mustn't be able to stall the controller, see send_ipc */
+	fcntl(pipeChild[1], F_SETFL, fcntl(pipeChild[1], F_GETFL) | O_NONBLOCK);
+	/* Convert to FILE handles */
+	strms[i][0] = fdopen(pipeParent[0], "r");
+	strms[i][1] = fdopen(pipeChild[1], "w");
+      }
+    }
+  }
+  return true;
+}
+
+void destroy_ipc(std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms, int numProcesses)
+{
+  for(int i=0; i < numProcesses; ++i){
+    if(procList[i].protocol == SnakeProtocolPlugin){
+      unload_plugin(procList[i]);
+      continue;
+    }
+    fclose(strms[i][0]);
+    fclose(strms[i][1]);
+    close_doorbells(procList[i]);
+    kill(procList[i].pid, 2);
+  }
+}
+
+/* Publishes the state once for every AI on the shared memory transport */
+static void publish_shm(const std::string& message, shmtransport_t& shm)
+{
+  SnakeShmStateHeader* header = (SnakeShmStateHeader*)shm.base;
+  unsigned int sequence = header->sequence;
+  __atomic_store_n(&header->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(shm.base + SNAKE_SHM_STATE_DATA_OFFSET, message.data(), message.size());
+  header->length = message.size();
+  __atomic_store_n(&header->tick, ++shm.tick, __ATOMIC_RELAXED);
+  __atomic_store_n(&header->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/* Writes as much of the message as the pipe takes right now, and keeps the rest in
+   proc.output for flush_output. A failed write shows up as a closed pipe in recv_ipc. */
+static void write_some(childproc_t& proc, int fd, struct iovec* iov, int count)
+{
+  ssize_t n;
+  do n = writev(fd, iov, count);
+  while(n < 0 && errno == EINTR);
+  if(n < 0) n = 0;
+  for(; count > 0; ++iov, --count){
+    if((size_t)n >= iov->iov_len){
+      n -= iov->iov_len;
+      continue;
+    }
+    proc.output.append((const char*)iov->iov_base + n, iov->iov_len - n);
+    n = 0;
+  }
+}
+
+/* Writes more of what the pipe had no room for earlier */
+static void flush_output(childproc_t& proc, int fd)
+{
+  ssize_t n;
+  do n = write(fd, proc.output.data(), proc.output.size());
+  while(n < 0 && errno == EINTR);
+  if(n > 0) proc.output.erase(0, n);
+  else if(n < 0 && errno != EAGAIN) proc.output.clear(); /* The AI is gone */
+}
+
+/* Sends the state to every live AI. Every message is encoded once for all the AIs that
+   want it, and goes out as the AI's own header (text: the currentPlayer line, binary:
+   the message header with currentPlayer patched in) followed by the shared body. */
+void send_ipc(SnakeGameInfo& state, std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms,
+	      shmtransport_t& shm, sendbuffers_t& buffers)
+{
+  bool textReady = false, fullReady = false, deltaReady = false, published = false;
+  /* The full state is encoded for player 0, the others get a patched header */
+  state.currentPlayer = 0;
+  for(int i=0; i < (int)strms.size(); ++i){
+    /* Plugins read the state directly when they're asked for their move */
+    if(procList[i].protocol == SnakeProtocolPlugin) continue;
+    if(!state.snakes[i].alive) continue;
+    /* Still not done reading the last state, let alone answering it. Queueing more would
+       only grow the backlog; it misses this tick instead, and a delta AI needs a full state
+       after the gap. */
+    procList[i].behind = !procList[i].output.empty();
+    if(procList[i].behind){
+      procList[i].fullStateSent = false;
+      procList[i].sentAt = stats_now_ns();
+      continue;
+    }
+    if(procList[i].protocol == SnakeProtocolSharedMemory){
+      uint64_t doorbell = 1;
+      if(!published){
+	if(!fullReady) snakeSerializeStateToBinary(state, buffers.full);
+	fullReady = true;
+	publish_shm(buffers.full, shm);
+	published = true;
+      }
+      (void)write(procList[i].tickfd, &doorbell, sizeof(doorbell));
+      procList[i].sentAt = stats_now_ns();
+      continue;
+    }
+
+    char header[SNAKE_BINARY_HEADER_SIZE];
+    struct iovec iov[2];
+    if(procList[i].protocol == SnakeProtocolText){
+      if(!textReady){
+	snakeSerializeSharedStateToStream(state, buffers.text);
+	buffers.text += "END\n";
+	textReady = true;
+      }
+      iov[0].iov_len = snprintf(header, sizeof(header), "%d\n", i);
+      iov[1].iov_base = (void*)buffers.text.data();
+      iov[1].iov_len = buffers.text.size();
+    } else {
+      const std::string* body;
+      if(procList[i].protocol == SnakeProtocolDelta && procList[i].fullStateSent){
+	if(!deltaReady) snakeSerializeDeltaToBinary(state, buffers.delta);
+	deltaReady = true;
+	body = &buffers.delta;
+      } else {
+	if(!fullReady) snakeSerializeStateToBinary(state, buffers.full);
+	fullReady = true;
+	body = &buffers.full;
+	procList[i].fullStateSent = true;
+      }
+      memcpy(header, body->data(), SNAKE_BINARY_HEADER_SIZE);
+      snakeBinarySetPlayer(header, i);
+      iov[0].iov_len = SNAKE_BINARY_HEADER_SIZE;
+      iov[1].iov_base = (void*)(body->data() + SNAKE_BINARY_HEADER_SIZE);
+      iov[1].iov_len = body->size() - SNAKE_BINARY_HEADER_SIZE;
+    }
+    iov[0].iov_base = header;
+    write_some(procList[i], fileno(strms[i][1]), iov, 2);
+    procList[i].sentAt = stats_now_ns();
+  }
+}
+
+/* Handles a "PROTOCOL <name>" request line */
+static void recv_protocol_request(childproc_t& proc, const std::string& line)
+{
+  char name[32];
+  SnakeProtocol protocol;
+  if(sscanf(line.c_str(), "PROTOCOL %31s", name) != 1) return;
+  if(snakeParseProtocolName(std::string(name), protocol) &&
+     (protocol != SnakeProtocolSharedMemory || proc.tickfd >= 0)){
+    proc.protocol = protocol;
+    proc.fullStateSent = false;
+  }
+  else
+    fprintf(stderr, "%s asked for unknown protocol \"%s\", keeping %s.\n",
+	    proc.path.c_str(), name, snakeProtocolName(proc.protocol));
+}
+
+/* Consumes what the AI has written to its pipe so far.
+   Returns true once the move for this tick has been found. */
+static bool parse_pipe_input(childproc_t& proc, Direction& move)
+{
+  size_t pos = 0;
+  bool found = false;
+  while(pos < proc.input.size() && !found){
+    char ch = proc.input[pos];
+    if(ch == 'P'){
+      /* Protocol requests come ahead of the move they belong to */
+      size_t eol = proc.input.find('\n', pos);
+      if(eol == std::string::npos) break;
+      recv_protocol_request(proc, proc.input.substr(pos, eol - pos));
+      pos = eol + 1;
+    } else if(proc.skipMoves > 0){
+      /* Late answer to a state we already gave up on */
+      --proc.skipMoves;
+      ++pos;
+    } else {
+      move = snakeCharToDirection(ch);
+      found = true;
+      ++pos;
+    }
+  }
+  proc.input.erase(0, pos);
+  return found;
+}
+
+/* Called when poll says the AI has written something. Returns true once its move is known. */
+static bool recv_ready(childproc_t& proc, bool viaShm, FILE* strm, const shmtransport_t& shm, int player,
+		       Direction& move)
+{
+  if(viaShm){
+    uint64_t doorbell;
+    const SnakeShmSlot* slot = shm_slot(shm, player);
+    if(read(proc.movefd, &doorbell, sizeof(doorbell)) != sizeof(doorbell)){
+      move = IllegalDirection;
+      return true;
+    }
+    /* A move left over from an earlier tick doesn't count */
+    if(__atomic_load_n(&slot->tick, __ATOMIC_ACQUIRE) != shm.tick) return false;
+    move = snakeCharToDirection((char)slot->move);
+    return true;
+  }
+
+  char buf[256];
+  ssize_t n = read(fileno(strm), buf, sizeof(buf));
+  if(n <= 0){
+    /* The AI closed its end or crashed */
+    move = IllegalDirection;
+    return true;
+  }
+  proc.input.append(buf, n);
+  return parse_pipe_input(proc, move);
+}
+
+/* Collects the moves of all AIs at once, so the tick takes as long as the slowest AI
+   instead of the sum of all of them. AIs that haven't answered when options.deadlineMs
+   runs out get options.defaultMove. */
+void recv_ipc(const SnakeGameInfo& state, std::vector<Direction>& inputs,
+	      std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms,
+	      const shmtransport_t& shm, const snakeoptions_t& options)
+{
+  std::vector<struct pollfd> fds;
+  std::vector<int> players;
+  std::vector<bool> waiting(strms.size(), false);
+  std::vector<bool> viaShm(strms.size(), false);
+  int waitingCount = 0;
+  bool lastLook = false;
+  /* The deadline counts from when the state went out, so work the controller does
+     between send_ipc and recv_ipc eats into the wait rather than extending it */
+  long long sentAt = stats_now_ns();
+  for(int i=0; i < (int)strms.size(); ++i)
+    if(state.snakes[i].alive && procList[i].protocol != SnakeProtocolPlugin && procList[i].sentAt < sentAt)
+      sentAt = procList[i].sentAt;
+  long long deadline = sentAt + options.deadlineMs * 1000000LL;
+
+  for(int i=0; i < (int)strms.size(); ++i){
+    procList[i].asked = state.snakes[i].alive;
+    if(!state.snakes[i].alive) continue;
+    procList[i].answeredAt = 0;
+    /* Not sent this state, so there's no answer to wait for */
+    if(procList[i].behind) continue;
+    /* In-process AIs answer right away, while the AI processes are still thinking */
+    if(procList[i].protocol == SnakeProtocolPlugin){
+      procList[i].sentAt = stats_now_ns();
+      inputs[i] = plugin_move(procList[i].plugin, procList[i].pluginContext, state);
+      procList[i].answeredAt = stats_now_ns();
+      continue;
+    }
+    /* A protocol request read below only takes effect from the next state on */
+    viaShm[i] = procList[i].protocol == SnakeProtocolSharedMemory;
+    /* The answer may already be buffered from an earlier read */
+    if(!viaShm[i] && parse_pipe_input(procList[i], inputs[i])){
+      procList[i].answeredAt = stats_now_ns();
+      continue;
+    }
+    waiting[i] = true;
+    ++waitingCount;
+  }
+
+  while(waitingCount > 0){
+    int timeout = -1;
+    if(options.deadlineMs > 0){
+      /* Round up, so we don't spin on a timeout of 0 just before the deadline */
+      timeout = (int)((deadline - stats_now_ns() + 999999) / 1000000);
+      /* Answers that came in before the deadline may still be unread, if the controller
+         was busy until after it. Take one last look without waiting before giving up. */
+      if(timeout <= 0){
+	if(lastLook) break;
+	lastLook = true;
+	timeout = 0;
+      }
+    }
+    fds.clear();
+    players.clear();
+    for(int i=0; i < (int)strms.size(); ++i){
+      struct pollfd pfd;
+      pfd.revents = 0;
+      /* Keep writing states the pipe had no room for, also to AIs that already missed theirs */
+      if(procList[i].asked && !procList[i].output.empty()){
+	pfd.fd = fileno(strms[i][1]);
+	pfd.events = POLLOUT;
+	fds.push_back(pfd);
+	players.push_back(i);
+      }
+      if(!waiting[i]) continue;
+      pfd.fd = viaShm[i] ? procList[i].movefd : fileno(strms[i][0]);
+      pfd.events = POLLIN;
+      fds.push_back(pfd);
+      players.push_back(i);
+    }
+    int ready = poll(&fds[0], fds.size(), timeout);
+    if(ready < 0 && errno == EINTR) continue;
+    if(ready <= 0) break;
+    for(int k=0; k < (int)fds.size(); ++k){
+      int i = players[k];
+      if(!fds[k].revents) continue;
+      if(fds[k].events == POLLOUT){
+	flush_output(procList[i], fds[k].fd);
+	continue;
+      }
+      if(recv_ready(procList[i], viaShm[i], strms[i][0], shm, i, inputs[i])){
+	procList[i].answeredAt = stats_now_ns();
+	waiting[i] = false;
+	--waitingCount;
+      }
+    }
+  }
+
+  /* Whoever is still missing ran out of time */
+  for(int i=0; i < (int)strms.size(); ++i){
+    bool missed = waiting[i] || (procList[i].asked && procList[i].behind);
+    if(procList[i].asked)
+      procList[i].latency = missed ? -1 : procList[i].answeredAt - procList[i].sentAt;
+    if(!missed) continue;
+    inputs[i] = options.defaultMove;
+    /* An AI that is behind never got this state, so it won't answer it either */
+    if(waiting[i] && !viaShm[i])
+      ++procList[i].skipMoves;
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef SNAKEIPC_HPP_GUARD
+#define SNAKEIPC_HPP_GUARD
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <boost/array.hpp>
+#include "shared/SnakeGame.hpp"
+#include "shared/SnakeSharedMemory.hpp"
+#include "SnakeMatch.hpp"
+#include "SnakeOptions.hpp"
+
+/* Process and pipe handling shared by the controllers (Snake and SnakeHeadless).
+   AIs given as shared objects are loaded in-process instead, see shared/SnakePlugin.hpp;
+   they have no process (pid -1) and no pipes (NULL streams). */
+
+typedef boost::array<FILE*, 2> pipearr_t;
+struct childproc_t
+{
+  pid_t pid;
+  std::string path;
+  /* Handed to the AI in SNAKE_SEED_ENV, so its own random choices can be replayed too */
+  uint64_t seed;
+  /* Handed to the AI in SNAKE_DEADLINE_ENV if > 0, so it knows how long it may think */
+  int deadlineMs;
+  /* Wire format the AI asked for, see SnakeProtocol */
+  SnakeProtocol protocol;
+  /* SnakeProtocolDelta only: set once the AI has a full state to apply deltas to */
+  bool fullStateSent;
+  /* Doorbells for the shared memory transport, -1 if it isn't offered */
+  int tickfd;
+  int movefd;
+  /* What the AI wrote to its pipe that hasn't been used yet */
+  std::string input;
+  /* Answers to states the AI missed the deadline for, which are thrown away on arrival */
+  int skipMoves;
+  /* The part of the last state its pipe had no room for. The pipe doesn't block, recv_ipc
+     writes the rest as the AI reads. */
+  std::string output;
+  /* Set by send_ipc when the AI hadn't even read the last state yet: it isn't sent the new
+     one and misses its deadline */
+  bool behind;
+  /* SnakeProtocolPlugin only: the loaded shared object and the AI's context,
+     NULL if it couldn't be loaded */
+  matchplugin_t plugin;
+  void* pluginContext;
+  /* When the last state went out and when its move came back (0 if it never did), in ns */
+  long long sentAt;
+  long long answeredAt;
+  /* Outcome of the last recv_ipc, kept for the stats once sentAt has moved on to the next state:
+     whether the AI was asked at all (it was alive), and how long it took, -1 if it missed the deadline */
+  bool asked;
+  long long latency;
+};
+
+/* Controller side of the shared memory transport, see shared/SnakeSharedMemory.hpp */
+struct shmtransport_t
+{
+  int memfd; /* The state pages, -1 if shared memory couldn't be set up */
+  unsigned char* base;
+  long size;
+  /* One memfd and page per player for its move slot */
+  std::vector<int> slotfds;
+  std::vector<SnakeShmSlot*> slots;
+  long pageSize;
+  unsigned int tick;
+};
+
+/* The messages of one tick. send_ipc encodes each wire format at most once per tick,
+   whoever speaks it; only the player id differs per AI and is written separately.
+   The buffers are kept from tick to tick, so in the steady state sending doesn't allocate. */
+struct sendbuffers_t
+{
+  std::string text;  /* Text state without its currentPlayer line, END included */
+  std::string full;  /* Binary full state, also what goes into shared memory */
+  std::string delta; /* Binary delta */
+};
+
+/* SnakeIPC.cpp */
+bool init_shm(const SnakeGameInfo& state, shmtransport_t& shm);
+void destroy_shm(shmtransport_t& shm);
+bool init_ipc(std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms, int numProcesses,
+	      const shmtransport_t& shm);
+void destroy_ipc(std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms, int numProcesses);
+void send_ipc(SnakeGameInfo& state, std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms,
+	      shmtransport_t& shm, sendbuffers_t& buffers);
+void recv_ipc(const SnakeGameInfo& state, std::vector<Direction>& inputs,
+	      std::vector<childproc_t>& procList, std::vector<pipearr_t>& strms,
+	      const shmtransport_t& shm, const snakeoptions_t& options);
+
+#endif
@@ -0,0 +1,80 @@
+#include <dlfcn.h>
+#include <cstdio>
+#include "SnakeMatch.hpp"
+
+/* Loads an AI shared object and checks that it was built against our SnakeGameInfo.
+   On failure nothing stays loaded and plugin.handle is NULL. */
+bool open_plugin(const std::string& path, matchplugin_t& plugin)
+{
+  /* Like execve, look for a bare file name in the working directory and not the library path */
+  std::string file = path.find('/') == std::string::npos ? "./" + path : path;
+  SnakePluginGetApi getApi;
+  const SnakePluginApi* api;
+
+  plugin.path = path;
+  plugin.api = NULL;
+  plugin.handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if(!plugin.handle){
+    fprintf(stderr, "Couldn't load %s: %s\n", path.c_str(), dlerror());
+    return false;
+  }
+  getApi = (SnakePluginGetApi)dlsym(plugin.handle, SNAKE_PLUGIN_ENTRY);
+  api = getApi ? getApi() : NULL;
+  if(!api || api->abiVersion != SNAKE_PLUGIN_ABI_VERSION || api->stateSize != (int)sizeof(SnakeGameInfo)){
+    fprintf(stderr, "%s isn't a compatible snake plugin.\n", path.c_str());
+    close_plugin(plugin);
+    return false;
+  }
+  plugin.api = api;
+  return true;
+}
+
+void close_plugin(matchplugin_t& plugin)
+{
+  if(plugin.handle) dlclose(plugin.handle);
+  plugin.handle = NULL;
+  plugin.api = NULL;
+}
+
+/* Asks a plugin AI for its move. Anything that isn't a direction, or an AI without
+   a context because it failed to load, is an illegal move. */
+Direction plugin_move(const matchplugin_t& plugin, void* context, const SnakeGameInfo& state)
+{
+  if(!context) return IllegalDirection;
+  int move = plugin.api->move(context, &state);
+  return move >= Up && move <= Right ? (Direction)move : IllegalDirection;
+}
+
+/* Plays result.seed to the end, or to a draw after maxTicks ticks (0 for no limit).
+   The state is reset here, so a worker can keep reusing the same one. */
+void run_match(SnakeGameInfo& state, const std::vector<std::string>& level,
+	       const std::vector<matchplugin_t>& players, int maxTicks, matchresult_t& result)
+{
+  int playerCount = players.size();
+  std::vector<void*> contexts(playerCount, (void*)NULL);
+  std::vector<Direction> inputs(playerCount, IllegalDirection);
+  int winner;
+
+  state.level = level;
+  state.levelWidth = level[0].length();
+  state.levelHeight = level.size();
+  state.vs = NULL;
+  snakeSeedRandom(state.rng, result.seed);
+  snakeInitSnakes(state, playerCount);
+  snakeInitFood(state);
+  /* Same seeds as the controllers would hand out, so a match can be replayed there */
+  for(int i = 0; i < playerCount; ++i)
+    if(players[i].api) contexts[i] = players[i].api->init(i, snakePlayerSeed(result.seed, i));
+
+  result.ticks = 0;
+  do {
+    for(int i = 0; i < playerCount; ++i)
+      if(state.snakes[i].alive) inputs[i] = plugin_move(players[i], contexts[i], state);
+    winner = snakeGameTick(state, inputs);
+    ++result.ticks;
+  } while(winner < 0 && (maxTicks <= 0 || result.ticks < maxTicks));
+  result.winner = winner < 0 ? 0 : winner;
+
+  for(int i = 0; i < playerCount; ++i)
+    if(contexts[i]) players[i].api->shutdown(contexts[i]);
+}
@@ -0,0 +1,38 @@
+#ifndef SNAKEMATCH_HPP_GUARD
+#define SNAKEMATCH_HPP_GUARD
+#include <string>
+#include <vector>
+#include "shared/SnakeGame.hpp"
+#include "shared/SnakePlugin.hpp"
+
+/*
+  Whole matches between plugin AIs (see shared/SnakePlugin.hpp), run without any
+  controller, process or pipe. Nothing here is global: every caller passes in its own
+  state, so matches can run side by side on different threads. A plugin's move is then
+  called from several threads at once, each time with its own context.
+*/
+
+/* A loaded plugin. Loading one shared object several times is fine, dlopen counts references. */
+struct matchplugin_t
+{
+  std::string path;
+  void* handle;
+  const SnakePluginApi* api;
+};
+
+struct matchresult_t
+{
+  int match;
+  uint64_t seed;
+  int winner; /* Player id + 1, 0 for a draw, like snakeGameTick */
+  int ticks;
+};
+
+/* SnakeMatch.cpp */
+bool open_plugin(const std::string& path, matchplugin_t& plugin);
+void close_plugin(matchplugin_t& plugin);
+Direction plugin_move(const matchplugin_t& plugin, void* context, const SnakeGameInfo& state);
+void run_match(SnakeGameInfo& state, const std::vector<std::string>& level,
+	       const std::vector<matchplugin_t>& players, int maxTicks, matchresult_t& result);
+
+#endif
@@ -0,0 +1,69 @@
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "SnakeOptions.hpp"
+
+void print_usage(const char* program)
+{
+  printf("Usage: %s [options] <levelFile> <AIprog1> ... <AIprogN>\n", program);
+  printf("Options:\n");
+  printf("  --deadline <ms>          Time every AI gets to answer a state (default: wait forever)\n");
+  printf("  --default-move <u|d|l|r|x>  Move for an AI that misses the deadline (default: x, the AI dies)\n");
+  printf("  --stats <file>           Write per-phase and per-AI timings as JSON (\"-\" for stdout)\n");
+  printf("  --replay <file>          Record the match, to look at it again with SnakeReplay\n");
+  printf("  --seed <n>               Seed for the match, to replay it exactly (default: from the clock)\n");
+  printf("  --speed <realtime|unlimited|n>  Snake only: real time, as fast as possible, or n times real time\n");
+  printf("  --render-every <n>       Snake only: draw every n'th tick (default: 1)\n");
+}
+
+/* Options come first, then the level and at least two AIs */
+bool parse_options(int argc, char* argv[], snakeoptions_t& options)
+{
+  int arg = 1;
+  options.seed = time(NULL);
+  for(; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg){
+    const char* name = argv[arg];
+    if(arg + 1 >= argc){
+      printf("Missing value for %s\n", name);
+      return false;
+    }
+    const char* value = argv[++arg];
+    if(strcmp(name, "--deadline") == 0){
+      char* end;
+      long deadlineMs = strtol(value, &end, 10);
+      if(*end != '\0' || end == value || deadlineMs < 0 || deadlineMs > INT_MAX) return false;
+      options.deadlineMs = deadlineMs;
+    } else if(strcmp(name, "--default-move") == 0){
+      options.defaultMove = snakeCharToDirection(value[0]);
+      if(options.defaultMove == IllegalDirection && strcmp(value, "x") != 0) return false;
+    } else if(strcmp(name, "--stats") == 0){
+      options.statsFile = value;
+    } else if(strcmp(name, "--replay") == 0){
+      options.replayFile = value;
+    } else if(strcmp(name, "--seed") == 0){
+      char* end;
+      options.seed = strtoull(value, &end, 10);
+      if(*end != '\0' || end == value) return false;
+    } else if(strcmp(name, "--speed") == 0){
+      if(strcmp(value, "realtime") == 0) options.speed = 1;
+      else if(strcmp(value, "unlimited") == 0) options.speed = 0;
+      else {
+	options.speed = atoi(value);
+	if(options.speed <= 0) return false;
+      }
+    } else if(strcmp(name, "--render-every") == 0){
+      options.renderEvery = atoi(value);
+      if(options.renderEvery <= 0) return false;
+    } else {
+      printf("Unknown option %s\n", name);
+      return false;
+    }
+  }
+  if(argc - arg < 3) return false;
+  options.levelFile = argv[arg++];
+  for(; arg < argc; ++arg)
+    options.aiPaths.push_back(argv[arg]);
+  return true;
+}
@@ -0,0 +1,34 @@
+#ifndef SNAKEOPTIONS_HPP_GUARD
+#define SNAKEOPTIONS_HPP_GUARD
+#include <string>
+#include <vector>
+#include "shared/SnakeGame.hpp"
+
+/* Command line options shared by the controllers (Snake and SnakeHeadless) */
+struct snakeoptions_t
+{
+  snakeoptions_t() : deadlineMs(0), defaultMove(IllegalDirection), seed(0), speed(1), renderEvery(1){}
+  std::string levelFile;
+  std::vector<std::string> aiPaths;
+  /* How long every AI gets to answer a state. 0 waits forever. */
+  int deadlineMs;
+  /* The move used for an AI that misses the deadline. IllegalDirection kills it. */
+  Direction defaultMove;
+  /* Where to write the JSON timing summary of the match, "-" for stdout. Empty for none. */
+  std::string statsFile;
+  /* Where to record the match for SnakeReplay. Empty for none. */
+  std::string replayFile;
+  /* Seeds the match random generator. Picked from the clock unless given with --seed. */
+  uint64_t seed;
+  /* Snake only: how many times faster than real time (SNAKE_TICK_MS per tick) the game runs,
+     0 for as fast as the AIs can go. */
+  int speed;
+  /* Snake only: draw every renderEvery'th tick */
+  int renderEvery;
+};
+
+/* SnakeOptions.cpp */
+bool parse_options(int argc, char* argv[], snakeoptions_t& options);
+void print_usage(const char* program);
+
+#endif
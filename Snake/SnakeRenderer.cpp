@@ -1,5 +1,6 @@
 #include "shared/SnakeGame.hpp"
 #include <cstring>
+#include <vector>
 #include <SDL/SDL.h>
 
 static void drawSquare(unsigned int* dst, int squareSize,
@@ -30,14 +31,48 @@ bool snakeShouldQuit()
   return false;
 }
 
+/* Static wall layer, drawn once in snakeInitGraphics, and what each cell
+   of the screen shows right now. See snakeRender. */
+static std::vector<unsigned int> levelLayer;
+static std::vector<int> drawnCells;
+/* The snakes and the food as last drawn, and per snake how many of its parts are on each cell.
+   Frames can be ticks apart, so the renderer keeps its own copy to tell what changed. */
+static std::vector<SnakeBody> drawnBodies;
+static std::vector<std::vector<int> > coverage;
+static Point drawnFood;
+static std::vector<int> dirtyCells; /* Cells whose contents may have changed, repeats are fine */
+static std::vector<SDL_Rect> dirtyRects;
+static bool firstFrame;
+
+static const int squareSize = 16;
+
+/* Cell contents besides the player ids */
+#define CELL_LEVEL -1 /* Just the level layer: empty, or a wall */
+#define CELL_FOOD -2
+
 bool snakeInitGraphics(SnakeGameInfo& state)
 {
-  const int squareSize = 16;
   int width = squareSize * state.levelWidth;
   int height = squareSize * state.levelHeight;
   SDL_Init(SDL_INIT_VIDEO);
-  state.vs = SDL_SetVideoMode(width, height, 32, SDL_SWSURFACE | SDL_DOUBLEBUF);
+  /* No SDL_DOUBLEBUF: only the changed cells are copied to the screen, see snakeRender */
+  state.vs = SDL_SetVideoMode(width, height, 32, SDL_SWSURFACE);
   if(!state.vs) return false;
+
+  levelLayer.assign(width * height, 0);
+  for(int y = 0; y < state.levelHeight; ++y)
+    for(int x = 0; x < state.levelWidth; ++x)
+      if(snakeIsCellBorder(x, y, state.level))
+	drawSquare(&levelLayer[0], squareSize, x * squareSize, y * squareSize, width, 255, 255, 255, 255);
+  drawnCells.assign(state.levelWidth * state.levelHeight, CELL_LEVEL);
+  drawnBodies.assign(state.playerCount, SnakeBody());
+  coverage.assign(state.playerCount, std::vector<int>(state.levelWidth * state.levelHeight, 0));
+  for(int eachSnake = 0; eachSnake < state.playerCount; ++eachSnake)
+    drawnBodies[eachSnake].reserve(state.levelWidth * state.levelHeight);
+  drawnFood = Point(-1, -1);
+  dirtyCells.reserve(state.levelWidth * state.levelHeight);
+  dirtyRects.reserve(state.levelWidth * state.levelHeight);
+  firstFrame = true;
   return true;
 }
 
@@ -46,52 +81,121 @@ void snakeDestroyGraphics()
   SDL_Quit();
 }
 
-void snakeRender(SnakeGameInfo& state)
+/* Redraw one cell: the level layer underneath, then whatever is on top of it */
+static void drawCell(SnakeGameInfo& state, int x, int y, int contents)
 {
-  const int squareSize = 16;
   const int colors[4][4] = {
     {255, 255, 255,   0},
     {255,   0,   0, 255},
     {255, 255,   0, 255},
     {255,   0, 255, 255}
   };
-
-  int width = state.vs->w;
-  int height = state.vs->h;
+  int layerPitch = squareSize * state.levelWidth;
   int pitch = state.vs->pitch / sizeof(int);
-
   unsigned int* pixels = (unsigned int*)state.vs->pixels;
-  /* Clear to red */
-  for(int i = 0; i < height*pitch; i+=pitch)
-    memset(&pixels[i], 0x0, sizeof(unsigned int) * width);
-
-  /* Draw food */
-  int foodX = state.foodPosition.x * squareSize;
-  int foodY = state.foodPosition.y * squareSize;
-
-  drawSquare(pixels, squareSize-4, foodX + 2, foodY + 2, pitch, 255, 128, 0, 0);
-
-  /* Draw level borders */
-  for(int j=0; j<height; j+=squareSize){
-    for(int i=0; i<width; i+=squareSize){
-      int mx = i/squareSize;
-      int my = j/squareSize;
-      bool mw = (state.level[my][mx] == 'x');
-      if(mw)
-	drawSquare(pixels, squareSize, i, j, pitch, 255, 255, 255, 255);
-    }
+  int px = x * squareSize;
+  int py = y * squareSize;
+
+  for(int j = py; j < py + squareSize; ++j)
+    memcpy(&pixels[j * pitch + px], &levelLayer[j * layerPitch + px], sizeof(unsigned int) * squareSize);
+  if(contents == CELL_FOOD)
+    drawSquare(pixels, squareSize-4, px + 2, py + 2, pitch, 255, 128, 0, 0);
+  else if(contents >= 0){
+    const int* playerColor = &colors[contents][0];
+    drawSquare(pixels, squareSize-2, px + 1, py + 1, pitch,
+	       playerColor[0], playerColor[1], playerColor[2], playerColor[3]);
   }
-  /* Draw snakes */
-  for(int eachSnake = 0; eachSnake < state.playerCount; ++eachSnake){
-    const int* playerColor = &colors[eachSnake][0];
-    for(int eachBodyPart = 0; eachBodyPart < state.snakes[eachSnake].bodyParts.size(); ++eachBodyPart){
-      Point bp = state.snakes[eachSnake].bodyParts[eachBodyPart];
-      bp.x *= squareSize;
-      bp.y *= squareSize;
-      drawSquare(pixels, squareSize-2, bp.x+1, bp.y+1, pitch,
-		   playerColor[0], playerColor[1], playerColor[2], playerColor[3]);
+  SDL_Rect rect = { (Sint16)px, (Sint16)py, (Uint16)squareSize, (Uint16)squareSize };
+  dirtyRects.push_back(rect);
+}
+
+static int cellIndex(const SnakeGameInfo& state, const Point& p)
+{
+  if(p.x < 0 || p.y < 0 || p.x >= state.levelWidth || p.y >= state.levelHeight) return -1;
+  return p.x + p.y * state.levelWidth;
+}
+
+static void coverCell(const SnakeGameInfo& state, int player, const Point& p, int change)
+{
+  int index = cellIndex(state, p);
+  if(index < 0) return;
+  coverage[player][index] += change;
+  dirtyCells.push_back(index);
+}
+
+/* Brings drawnBodies[player] up to the snake's body, marking the cells that came and went.
+   Since the last frame the snake has moved some steps, each adding a head and, unless it was
+   growing, dropping the tail. So the old head is in the new body, as many parts back as it
+   moved. If it can't be lined up like that, the whole body is redone. */
+static void updateBody(const SnakeGameInfo& state, int player)
+{
+  const SnakeBody& body = state.snakes[player].bodyParts;
+  SnakeBody& drawn = drawnBodies[player];
+  int moved = -1;
+  if(drawn.size() > 0)
+    for(int eachBodyPart = 0; eachBodyPart < body.size() && moved < 0; ++eachBodyPart)
+      if(body[eachBodyPart] == drawn.head()) moved = eachBodyPart;
+  if(moved >= 0 && drawn.size() + moved >= body.size()){
+    for(int eachBodyPart = moved - 1; eachBodyPart >= 0; --eachBodyPart){
+      drawn.pushHead(body[eachBodyPart]);
+      coverCell(state, player, body[eachBodyPart], 1);
+    }
+    while(drawn.size() > body.size()){
+      coverCell(state, player, drawn.tail(), -1);
+      drawn.popTail();
     }
+    if(drawn.size() == 0 || drawn.tail() == body.tail()) return;
+  }
+  while(drawn.size() > 0){
+    coverCell(state, player, drawn.tail(), -1);
+    drawn.popTail();
+  }
+  for(int eachBodyPart = 0; eachBodyPart < body.size(); ++eachBodyPart){
+    drawn.pushTail(body[eachBodyPart]);
+    coverCell(state, player, body[eachBodyPart], 1);
+  }
+}
+
+/* Draws just the cells that changed since the last frame. Per tick that's the heads,
+   the tails and the food, and only those regions are sent to the screen. */
+void snakeRender(SnakeGameInfo& state)
+{
+  int width = state.levelWidth;
+
+  dirtyCells.clear();
+  if(!(state.foodPosition == drawnFood)){
+    if(cellIndex(state, drawnFood) >= 0) dirtyCells.push_back(cellIndex(state, drawnFood));
+    if(cellIndex(state, state.foodPosition) >= 0) dirtyCells.push_back(cellIndex(state, state.foodPosition));
+    drawnFood = state.foodPosition;
+  }
+  for(int eachSnake = 0; eachSnake < state.playerCount; ++eachSnake)
+    updateBody(state, eachSnake);
+
+  if(firstFrame){
+    /* Start from the plain level layer, all of it */
+    int pitch = state.vs->pitch / sizeof(int);
+    int layerPitch = squareSize * width;
+    unsigned int* pixels = (unsigned int*)state.vs->pixels;
+    for(int j = 0; j < state.vs->h; ++j)
+      memcpy(&pixels[j * pitch], &levelLayer[j * layerPitch], sizeof(unsigned int) * layerPitch);
+  }
+  dirtyRects.clear();
+  for(int i = 0; i < (int)dirtyCells.size(); ++i){
+    int index = dirtyCells[i];
+    /* Dead snakes stay on screen. Later snakes are drawn over earlier ones. */
+    int contents = index == cellIndex(state, state.foodPosition) ? CELL_FOOD : CELL_LEVEL;
+    for(int eachSnake = state.playerCount - 1; eachSnake >= 0; --eachSnake)
+      if(coverage[eachSnake][index] > 0){
+	contents = eachSnake;
+	break;
+      }
+    if(contents == drawnCells[index]) continue;
+    drawCell(state, index % width, index / width, contents);
+    drawnCells[index] = contents;
   }
-  SDL_Flip(state.vs);
-  SDL_Delay(50);
+  if(firstFrame){
+    SDL_UpdateRect(state.vs, 0, 0, 0, 0);
+    firstFrame = false;
+  } else if(!dirtyRects.empty())
+    SDL_UpdateRects(state.vs, dirtyRects.size(), &dirtyRects[0]);
 }
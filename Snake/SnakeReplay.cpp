@@ -0,0 +1,331 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include "SnakeReplay.hpp"
+
+static void putU16(std::string& strm, unsigned int v)
+{
+  strm += (char)(v & 0xff);
+  strm += (char)((v >> 8) & 0xff);
+}
+
+static void putU32(std::string& strm, uint32_t v)
+{
+  for(int b = 0; b < 4; ++b)
+    strm += (char)((v >> (8 * b)) & 0xff);
+}
+
+static void putU64(std::string& strm, uint64_t v)
+{
+  for(int b = 0; b < 8; ++b)
+    strm += (char)((v >> (8 * b)) & 0xff);
+}
+
+static unsigned int getU16(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t getU64(const unsigned char* p)
+{
+  return getU32(p) | ((uint64_t)getU32(p + 4) << 32);
+}
+
+/* Free cells take two bytes each, unless the level has too many cells for that */
+static int freeCellSize(int levelWidth, int levelHeight)
+{
+  return levelWidth * levelHeight > 65536 ? 4 : 2;
+}
+
+/* Bytes taken by the moves of ticks ticks */
+static size_t moveBytes(int playerCount, int ticks)
+{
+  return ((size_t)ticks * playerCount * 2 + 7) / 8;
+}
+
+/* FNV-1a over the size and the walls of the level, so a replay can be matched with a level file */
+uint64_t replay_level_hash(const SnakeGameInfo& state)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  int values[2] = { state.levelWidth, state.levelHeight };
+  for(int i = 0; i < 2; ++i)
+    for(int b = 0; b < 4; ++b)
+      hash = (hash ^ ((values[i] >> (8 * b)) & 0xff)) * 1099511628211ULL;
+  for(int y = 0; y < state.levelHeight; ++y)
+    for(int x = 0; x < state.levelWidth; ++x)
+      hash = (hash ^ (snakeIsCellBorder(x, y, state.level) ? 1 : 0)) * 1099511628211ULL;
+  return hash;
+}
+
+static void encodeKeyframe(std::string& keyframe, const SnakeGameInfo& state)
+{
+  std::string message;
+  keyframe.clear();
+  for(int i = 0; i < 4; ++i)
+    putU64(keyframe, state.rng.s[i]);
+  snakeSerializeStateToBinary(state, message);
+  keyframe += message;
+  putU32(keyframe, state.freeCells.size());
+  bool wide = freeCellSize(state.levelWidth, state.levelHeight) == 4;
+  for(int i = 0; i < (int)state.freeCells.size(); ++i){
+    if(wide) putU32(keyframe, state.freeCells[i]);
+    else putU16(keyframe, state.freeCells[i]);
+  }
+}
+
+/* Starts a new block with the keyframe in replay.keyframe */
+static void writeKeyframe(replaywriter_t& replay)
+{
+  replay.blockOffsets.push_back(ftell(replay.file));
+  fwrite(replay.keyframe.data(), 1, replay.keyframe.size(), replay.file);
+  replay.moves.clear();
+}
+
+/* Starts recording a match, with state as it is before the first tick.
+   On failure nothing is recorded and the replay functions do nothing. */
+bool replay_open(replaywriter_t& replay, const std::string& fileName, const SnakeGameInfo& state,
+		 const std::vector<std::string>& players, uint64_t seed)
+{
+  std::string header;
+  replay.file = fopen(fileName.c_str(), "wb");
+  if(!replay.file) return false;
+  replay.playerCount = state.playerCount;
+  replay.tickCount = 0;
+  replay.alive.resize(state.playerCount);
+  for(int i = 0; i < state.playerCount; ++i)
+    replay.alive[i] = state.snakes[i].alive;
+  replay.blockOffsets.clear();
+  replay.forfeits.clear();
+  /* The first keyframe is as large as any, the bodies only grow into cells that were free */
+  encodeKeyframe(replay.keyframe, state);
+  replay.keyframeInterval = REPLAY_MIN_KEYFRAME_INTERVAL;
+  while(replay.keyframeInterval < REPLAY_MAX_KEYFRAME_INTERVAL &&
+	moveBytes(replay.playerCount, replay.keyframeInterval) < replay.keyframe.size())
+    replay.keyframeInterval *= 2;
+
+  header.append(REPLAY_MAGIC, 4);
+  header += (char)REPLAY_VERSION;
+  header.append(3, '\0');
+  putU16(header, state.playerCount);
+  putU16(header, state.levelWidth);
+  putU16(header, state.levelHeight);
+  putU16(header, 0);
+  putU64(header, seed);
+  putU64(header, replay_level_hash(state));
+  putU32(header, replay.keyframeInterval);
+  /* Tick count, winner, block count, forfeit count and index offset, see replay_close */
+  header.append(20, '\0');
+  for(int i = 0; i < (int)players.size(); ++i){
+    putU16(header, players[i].size());
+    header += players[i];
+  }
+  fwrite(header.data(), 1, header.size(), replay.file);
+  writeKeyframe(replay);
+  return true;
+}
+
+/* Records the moves of one tick, with state as the tick left it */
+void replay_record(replaywriter_t& replay, const std::vector<Direction>& inputs, const SnakeGameInfo& state)
+{
+  if(!replay.file) return;
+  int tickInBlock = replay.tickCount % replay.keyframeInterval;
+  replay.moves.resize(moveBytes(replay.playerCount, tickInBlock + 1), 0);
+  for(int i = 0; i < replay.playerCount; ++i){
+    if(!replay.alive[i]) continue;
+    if(inputs[i] == IllegalDirection){
+      replayforfeit_t forfeit = { replay.tickCount, i };
+      replay.forfeits.push_back(forfeit);
+      continue;
+    }
+    int bit = (tickInBlock * replay.playerCount + i) * 2;
+    replay.moves[bit >> 3] |= (unsigned char)(inputs[i] << (bit & 7));
+  }
+  for(int i = 0; i < replay.playerCount; ++i)
+    replay.alive[i] = state.snakes[i].alive;
+  ++replay.tickCount;
+  if(replay.tickCount % replay.keyframeInterval == 0){
+    fwrite(&replay.moves[0], 1, replay.moves.size(), replay.file);
+    encodeKeyframe(replay.keyframe, state);
+    writeKeyframe(replay);
+  }
+}
+
+/* Writes the rest of the moves and the index, and fills in the header.
+   Returns false if anything couldn't be written. */
+bool replay_close(replaywriter_t& replay, int winner)
+{
+  std::string index, tail;
+  if(!replay.file) return true;
+  if(!replay.moves.empty())
+    fwrite(&replay.moves[0], 1, replay.moves.size(), replay.file);
+  uint32_t indexOffset = ftell(replay.file);
+  for(int i = 0; i < (int)replay.blockOffsets.size(); ++i)
+    putU32(index, replay.blockOffsets[i]);
+  for(int i = 0; i < (int)replay.forfeits.size(); ++i){
+    putU32(index, replay.forfeits[i].tick);
+    putU16(index, replay.forfeits[i].player);
+  }
+  fwrite(index.data(), 1, index.size(), replay.file);
+
+  putU32(tail, replay.tickCount);
+  putU32(tail, (uint32_t)winner);
+  putU32(tail, replay.blockOffsets.size());
+  putU32(tail, replay.forfeits.size());
+  putU32(tail, indexOffset);
+  fseek(replay.file, REPLAY_HEADER_SIZE - tail.size(), SEEK_SET);
+  fwrite(tail.data(), 1, tail.size(), replay.file);
+  bool ok = !ferror(replay.file);
+  if(fclose(replay.file) != 0) ok = false;
+  replay.file = NULL;
+  return ok;
+}
+
+/* Maps a replay file and checks that its header and index are in one piece */
+bool replay_load(replay_t& replay, const std::string& fileName)
+{
+  struct stat st;
+  replay.data = NULL;
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+  if(fstat(fd, &st) < 0 || st.st_size < REPLAY_HEADER_SIZE){
+    close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED) return false;
+  replay.data = (const unsigned char*)data;
+  replay.size = st.st_size;
+
+  const unsigned char* p = replay.data;
+  replay.playerCount = getU16(p + 8);
+  replay.levelWidth = getU16(p + 10);
+  replay.levelHeight = getU16(p + 12);
+  replay.seed = getU64(p + 16);
+  replay.levelHash = getU64(p + 24);
+  replay.keyframeInterval = getU32(p + 32);
+  replay.tickCount = getU32(p + 36);
+  replay.winner = (int32_t)getU32(p + 40);
+  replay.blockCount = getU32(p + 44);
+  uint32_t forfeitCount = getU32(p + 48);
+  uint32_t indexOffset = getU32(p + 52);
+  /* An index offset of 0 is a match that never ended, its blocks can't be found. The
+     players are between the header and the index, so it can't be any lower than that. */
+  if(memcmp(p, REPLAY_MAGIC, 4) != 0 || p[4] != REPLAY_VERSION || indexOffset < REPLAY_HEADER_SIZE ||
+     replay.playerCount == 0 || replay.keyframeInterval <= 0 || replay.keyframeInterval > REPLAY_MAX_KEYFRAME_INTERVAL ||
+     replay.tickCount < 0 ||
+     replay.blockCount != replay.tickCount / replay.keyframeInterval + 1 ||
+     indexOffset > replay.size || (replay.size - indexOffset) / 4 < (size_t)replay.blockCount ||
+     (replay.size - indexOffset - 4 * (size_t)replay.blockCount) / 6 < forfeitCount){
+    replay_unload(replay);
+    return false;
+  }
+
+  size_t pos = REPLAY_HEADER_SIZE;
+  replay.players.resize(replay.playerCount);
+  for(int i = 0; i < replay.playerCount; ++i){
+    if(pos + 2 > indexOffset || pos + 2 + getU16(p + pos) > indexOffset){
+      replay_unload(replay);
+      return false;
+    }
+    replay.players[i].assign((const char*)p + pos + 2, getU16(p + pos));
+    pos += 2 + getU16(p + pos);
+  }
+
+  replay.blockIndex = p + indexOffset;
+  const unsigned char* forfeit = replay.blockIndex + 4 * replay.blockCount;
+  replay.forfeits.resize(forfeitCount);
+  for(uint32_t i = 0; i < forfeitCount; ++i, forfeit += 6){
+    replay.forfeits[i].tick = getU32(forfeit);
+    replay.forfeits[i].player = getU16(forfeit + 4);
+  }
+  return true;
+}
+
+void replay_unload(replay_t& replay)
+{
+  if(replay.data) munmap((void*)replay.data, replay.size);
+  replay.data = NULL;
+}
+
+/* Finds the keyframe and the moves of a block. Returns false if the block runs past
+   the index, so nothing after this has to check the bounds again. */
+static bool findBlock(const replay_t& replay, int block, const unsigned char*& keyframe, const unsigned char*& moves)
+{
+  size_t begin = getU32(replay.blockIndex + 4 * block);
+  size_t end = replay.blockIndex - replay.data;
+  if(begin < REPLAY_HEADER_SIZE || begin > end || end - begin < 32 + SNAKE_BINARY_HEADER_SIZE) return false;
+  keyframe = replay.data + begin;
+  int messageLength = snakeBinaryMessageLength((const char*)keyframe + 32);
+  if(messageLength < 0 || keyframe[32 + 5] != SnakeMessageFullState || end - begin - 32 - 4 < (size_t)messageLength)
+    return false;
+  const unsigned char* freeCells = keyframe + 32 + messageLength;
+  size_t freeCellBytes = (size_t)getU32(freeCells) * freeCellSize(replay.levelWidth, replay.levelHeight);
+  if((size_t)(replay.data + end - freeCells) - 4 < freeCellBytes) return false;
+  moves = freeCells + 4 + freeCellBytes;
+  int ticks = replay.tickCount - block * replay.keyframeInterval;
+  if(ticks > replay.keyframeInterval) ticks = replay.keyframeInterval;
+  return (size_t)(replay.data + end - moves) >= moveBytes(replay.playerCount, ticks);
+}
+
+/* The moves that took the game from tick to tick + 1 */
+bool replay_moves(const replay_t& replay, int tick, std::vector<Direction>& inputs)
+{
+  const unsigned char* keyframe;
+  const unsigned char* moves;
+  if(tick < 0 || tick >= replay.tickCount) return false;
+  int block = tick / replay.keyframeInterval;
+  if(!findBlock(replay, block, keyframe, moves)) return false;
+  int tickInBlock = tick - block * replay.keyframeInterval;
+  inputs.resize(replay.playerCount);
+  for(int i = 0; i < replay.playerCount; ++i){
+    int bit = (tickInBlock * replay.playerCount + i) * 2;
+    inputs[i] = (Direction)((moves[bit >> 3] >> (bit & 7)) & 3);
+  }
+  for(int i = 0; i < (int)replay.forfeits.size(); ++i)
+    if(replay.forfeits[i].tick == tick && replay.forfeits[i].player < replay.playerCount)
+      inputs[replay.forfeits[i].player] = IllegalDirection;
+  return true;
+}
+
+/* Puts state at tick (0 is the start, tickCount the end of the match): the nearest
+   keyframe before it, played forward with the recorded moves. */
+bool replay_seek(const replay_t& replay, int tick, SnakeGameInfo& state)
+{
+  const unsigned char* keyframe;
+  const unsigned char* moves;
+  std::vector<Direction> inputs;
+  std::vector<int> freeCells;
+  if(tick < 0 || tick > replay.tickCount) return false;
+  int block = tick / replay.keyframeInterval;
+  if(!findBlock(replay, block, keyframe, moves)) return false;
+
+  const unsigned char* message = keyframe + 32;
+  if(!snakeSerializeBinaryToState(state, (const char*)message, snakeBinaryMessageLength((const char*)message)))
+    return false;
+  if(state.playerCount != replay.playerCount || state.levelWidth != replay.levelWidth ||
+     state.levelHeight != replay.levelHeight)
+    return false;
+  for(int i = 0; i < 4; ++i)
+    state.rng.s[i] = getU64(keyframe + 8 * i);
+  const unsigned char* p = message + snakeBinaryMessageLength((const char*)message);
+  bool wide = freeCellSize(replay.levelWidth, replay.levelHeight) == 4;
+  freeCells.resize(getU32(p));
+  p += 4;
+  for(int i = 0; i < (int)freeCells.size(); ++i, p += wide ? 4 : 2)
+    freeCells[i] = wide ? getU32(p) : getU16(p);
+  if(!snakeRestoreFreeCells(state, freeCells)) return false;
+
+  for(int t = block * replay.keyframeInterval; t < tick; ++t){
+    replay_moves(replay, t, inputs);
+    snakeGameTick(state, inputs);
+  }
+  return true;
+}
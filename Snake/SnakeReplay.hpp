@@ -0,0 +1,123 @@
+#ifndef SNAKEREPLAY_HPP_GUARD
+#define SNAKEREPLAY_HPP_GUARD
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "shared/SnakeGame.hpp"
+
+/*
+  Replay files, so a match can be watched and checked again after the fact.
+
+  The game is deterministic, so a replay is little more than the moves: 2 bits per player
+  and tick. To get to any tick without simulating the whole game, the ticks are split into
+  blocks of the keyframe interval. Every block starts with a keyframe, the full state at
+  its first tick, and the file ends with an index of where the blocks start. Seeking
+  takes one keyframe and less than one interval of ticks.
+
+  The interval is a power of two between REPLAY_MIN_KEYFRAME_INTERVAL and
+  REPLAY_MAX_KEYFRAME_INTERVAL, the smallest one for which the moves of a block take at
+  least as much room as a keyframe. On large levels the keyframes are large, and they
+  would make up most of the file otherwise. A tick takes well under a microsecond to
+  simulate, so even the longest interval seeks in a few milliseconds.
+
+  All fields are little endian.
+
+  Header, REPLAY_HEADER_SIZE bytes:
+  [magic "SNKR", 4 bytes]
+  [version, u8]
+  [reserved, 3 bytes]
+  [playerCount, u16]
+  [levelWidth, u16]
+  [levelHeight, u16]
+  [reserved, u16]
+  [seed, u64]
+  [level hash, u64, see replay_level_hash]
+  [keyframe interval, u32]
+  [tick count, u32]
+  [winner, i32, as returned by snakeGameTick, -1 if the match was stopped]
+  [block count, u32]
+  [forfeit count, u32]
+  [index offset, u32, 0 while the match is still being written]
+  The fields from the tick count on are filled in when the match ends.
+
+  Players, one after the other:
+  [path length, u16]
+  [path]
+
+  Blocks, one after the other:
+  [keyframe rng, 4 x u64]
+  [keyframe state, a binary full state message, see shared/SnakeSerialization.cpp]
+  [keyframe free cell count, u32]
+  [keyframe free cells, u16 per cell (u32 on levels of more than 65536 cells)]
+  [moves, 2 bits per player and tick, the Direction, lowest bits first]
+
+  The food is placed at a random position in the free cell set, so the keyframe keeps the
+  set in the order the game had it. The moves of a player that is dead are 0.
+
+  Index, at the index offset:
+  [block offset, u32] per block
+  [tick, u32][player, u16] per forfeit
+
+  A forfeit is an AI that crashed, quit or missed its deadline (without --default-move)
+  and got IllegalDirection, which has no 2-bit code of its own.
+*/
+
+#define REPLAY_MAGIC "SNKR"
+#define REPLAY_VERSION 1
+#define REPLAY_HEADER_SIZE 56
+#define REPLAY_MIN_KEYFRAME_INTERVAL 1024
+#define REPLAY_MAX_KEYFRAME_INTERVAL 16384
+
+struct replayforfeit_t
+{
+  int tick;
+  int player;
+};
+
+/* Writing side, used by the controllers */
+struct replaywriter_t
+{
+  replaywriter_t() : file(NULL){}
+  FILE* file; /* NULL when not recording */
+  int playerCount;
+  int keyframeInterval;
+  int tickCount;
+  std::vector<unsigned char> moves; /* Moves of the current block, written when it is full */
+  std::vector<bool> alive; /* Who was alive before the tick being recorded */
+  std::vector<uint32_t> blockOffsets;
+  std::vector<replayforfeit_t> forfeits;
+  std::string keyframe;
+};
+
+/* Reading side. The file is mapped, nothing is read until a tick is asked for. */
+struct replay_t
+{
+  const unsigned char* data;
+  size_t size;
+  int playerCount;
+  int levelWidth;
+  int levelHeight;
+  uint64_t seed;
+  uint64_t levelHash;
+  int keyframeInterval;
+  int tickCount;
+  int winner;
+  int blockCount;
+  std::vector<std::string> players;
+  std::vector<replayforfeit_t> forfeits;
+  const unsigned char* blockIndex;
+};
+
+/* SnakeReplay.cpp */
+uint64_t replay_level_hash(const SnakeGameInfo& state);
+bool replay_open(replaywriter_t& replay, const std::string& fileName, const SnakeGameInfo& state,
+		 const std::vector<std::string>& players, uint64_t seed);
+void replay_record(replaywriter_t& replay, const std::vector<Direction>& inputs, const SnakeGameInfo& state);
+bool replay_close(replaywriter_t& replay, int winner);
+bool replay_load(replay_t& replay, const std::string& fileName);
+void replay_unload(replay_t& replay);
+bool replay_seek(const replay_t& replay, int tick, SnakeGameInfo& state);
+bool replay_moves(const replay_t& replay, int tick, std::vector<Direction>& inputs);
+
+#endif
@@ -0,0 +1,188 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "shared/SnakeGame.hpp"
+#include "shared/SnakeCompact.hpp"
+#include "SnakeReplay.hpp"
+
+/*
+  Looks into replay files written by Snake and SnakeHeadless with --replay.
+  Without options it prints what the file holds. --tick n draws the board at tick n,
+  --verify plays the whole match again and checks it against every keyframe.
+*/
+
+static double now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void print_usage(const char* program)
+{
+  printf("Usage: %s [options] <replayFile>\n", program);
+  printf("Options:\n");
+  printf("  --tick <n>               Draw the board at tick n (0 is the start of the match)\n");
+  printf("  --verify                 Play the match again from the start and compare it with the keyframes\n");
+  printf("  --level <file>           Check that the replay was recorded on this level\n");
+}
+
+/* Walls are x, food is *, heads are A, B, .. and bodies a, b, .. Dead snakes aren't drawn. */
+static void print_state(const SnakeGameInfo& state)
+{
+  std::vector<std::string> board = state.level;
+  for(int y = 0; y < state.levelHeight; ++y)
+    for(int x = 0; x < state.levelWidth; ++x)
+      if(board[y][x] != 'x') board[y][x] = ' ';
+  if(state.foodPosition.x >= 0)
+    board[state.foodPosition.y][state.foodPosition.x] = '*';
+  for(int i = 0; i < state.playerCount; ++i){
+    const SnakeInfo& snake = state.snakes[i];
+    if(!snake.alive) continue;
+    for(int j = snake.bodyParts.size() - 1; j >= 0; --j){
+      Point p = snake.bodyParts[j];
+      if(p.x < 0 || p.y < 0 || p.x >= state.levelWidth || p.y >= state.levelHeight) continue;
+      board[p.y][p.x] = (j == 0 ? 'A' : 'a') + i % 26;
+    }
+  }
+  for(int y = 0; y < state.levelHeight; ++y)
+    printf("%s\n", board[y].c_str());
+  for(int i = 0; i < state.playerCount; ++i)
+    printf("Player %d: %s, length %d\n", i + 1, state.snakes[i].alive ? "alive" : "dead",
+	   state.snakes[i].bodyParts.size());
+}
+
+enum roundtrip_t { RoundTripOk, RoundTripLost, RoundTripSkipped };
+
+/* Takes the state to a SnakeCompactState and back, and checks that nothing got lost on the
+   way, the free cell order included, so food lands in the same places afterwards.
+   Levels too large for the compact state are skipped. */
+static roundtrip_t compact_round_trip(const SnakeGameInfo& state)
+{
+  SnakeCompactState compact, again;
+  SnakeGameInfo restored;
+  if(!snakeCompactFromState(state, compact)) return RoundTripSkipped;
+  snakeCompactToState(compact, restored);
+  if(!snakeCompactFromState(restored, again) || memcmp(&compact, &again, sizeof(compact)) != 0 ||
+     restored.hash != state.hash || restored.freeCells != state.freeCells)
+    return RoundTripLost;
+  return RoundTripOk;
+}
+
+/* Plays the match through from tick 0, comparing the state with every keyframe on the way.
+   Every keyframe also goes through the compact state, see shared/SnakeCompact.hpp. */
+static bool verify(const replay_t& replay)
+{
+  SnakeGameInfo state, keyframe;
+  std::vector<Direction> inputs;
+  int result = -1;
+  if(!replay_seek(replay, 0, state)) return false;
+  /* The level and the players stay the same, so if the start doesn't fit nothing does */
+  roundtrip_t roundTrip = compact_round_trip(state);
+  if(roundTrip == RoundTripLost){
+    printf("The starting state doesn't survive the compact state\n");
+    return false;
+  }
+  if(roundTrip == RoundTripSkipped)
+    printf("The level doesn't fit the compact state, skipping its checks\n");
+  for(int tick = 0; tick < replay.tickCount; ++tick){
+    if(result >= 0){
+      printf("The match ended at tick %d, but the replay goes on\n", tick);
+      return false;
+    }
+    replay_moves(replay, tick, inputs);
+    result = snakeGameTick(state, inputs);
+    if((tick + 1) % replay.keyframeInterval != 0) continue;
+    if(!replay_seek(replay, tick + 1, keyframe)){
+      printf("Keyframe at tick %d is damaged\n", tick + 1);
+      return false;
+    }
+    if(keyframe.hash != state.hash || keyframe.freeCells != state.freeCells ||
+       memcmp(&keyframe.rng, &state.rng, sizeof(state.rng)) != 0){
+      printf("Keyframe at tick %d doesn't match the game played up to it\n", tick + 1);
+      return false;
+    }
+    if(roundTrip != RoundTripSkipped && compact_round_trip(state) == RoundTripLost){
+      printf("The state at tick %d doesn't survive the compact state\n", tick + 1);
+      return false;
+    }
+  }
+  /* A stopped match (winner -1) just ends wherever it was stopped */
+  if(replay.winner >= 0 && result != replay.winner){
+    printf("The match played again ends with %d, the replay says %d\n", result, replay.winner);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int tick = -1;
+  bool verifyReplay = false;
+  const char* levelFile = NULL;
+  int arg = 1;
+  for(; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg){
+    if(strcmp(argv[arg], "--verify") == 0){
+      verifyReplay = true;
+      continue;
+    }
+    if(arg + 1 >= argc){
+      printf("Missing value for %s\n", argv[arg]);
+      return 1;
+    }
+    if(strcmp(argv[arg], "--tick") == 0) tick = atoi(argv[++arg]);
+    else if(strcmp(argv[arg], "--level") == 0) levelFile = argv[++arg];
+    else {
+      printf("Unknown option %s\n", argv[arg]);
+      return 1;
+    }
+  }
+  if(arg != argc - 1){
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  replay_t replay;
+  if(!replay_load(replay, argv[arg])){
+    printf("\"%s\" isn't a finished replay\n", argv[arg]);
+    return 1;
+  }
+  printf("Seed %llu, level %dx%d (hash %016llx), %d ticks, ", (unsigned long long)replay.seed,
+	 replay.levelWidth, replay.levelHeight, (unsigned long long)replay.levelHash, replay.tickCount);
+  if(replay.winner < 0) printf("stopped before the end\n");
+  else if(replay.winner == 0) printf("a draw\n");
+  else printf("player %d won\n", replay.winner);
+  for(int i = 0; i < replay.playerCount; ++i)
+    printf("Player %d: %s\n", i + 1, replay.players[i].c_str());
+  printf("%d keyframes, %llu bytes\n", replay.blockCount, (unsigned long long)replay.size);
+
+  int ret = 0;
+  if(levelFile){
+    SnakeGameInfo level;
+    if(!snakeInitLevel(levelFile, level)){
+      printf("Couldn't open level \"%s\"\n", levelFile);
+      ret = 1;
+    } else if(replay_level_hash(level) != replay.levelHash){
+      printf("The replay was recorded on another level than \"%s\"\n", levelFile);
+      ret = 1;
+    }
+  }
+  if(tick >= 0){
+    SnakeGameInfo state;
+    double start = now_ms();
+    if(!replay_seek(replay, tick, state)){
+      printf("Couldn't seek to tick %d\n", tick);
+      ret = 1;
+    } else {
+      printf("Tick %d (found in %.3f ms):\n", tick, now_ms() - start);
+      print_state(state);
+    }
+  }
+  if(verifyReplay){
+    if(verify(replay)) printf("Verified: the moves replay to every keyframe and to the recorded result\n");
+    else ret = 1;
+  }
+  replay_unload(replay);
+  return ret;
+}
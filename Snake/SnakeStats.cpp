@@ -0,0 +1,144 @@
+#include <time.h>
+#include <cstring>
+#include "SnakeStats.hpp"
+
+long long stats_now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+histogram_t::histogram_t() : count(0), total(0), max(0), buckets(STATS_BUCKETS, 0)
+{
+}
+
+/* Values below STATS_SUB_BUCKETS get a bucket each. Above that the bucket is picked from
+   the position of the highest set bit and the STATS_SUB_BUCKETS values right below it. */
+static int bucket_index(long long ns)
+{
+  if(ns < STATS_SUB_BUCKETS) return (int)ns;
+  int msb = 63 - __builtin_clzll((unsigned long long)ns);
+  int sub = (int)((ns >> (msb - 4)) & (STATS_SUB_BUCKETS - 1));
+  return STATS_SUB_BUCKETS + (msb - 4) * STATS_SUB_BUCKETS + sub;
+}
+
+/* Largest value that goes in a bucket */
+static long long bucket_upper_bound(int index)
+{
+  if(index < STATS_SUB_BUCKETS) return index;
+  int msb = (index - STATS_SUB_BUCKETS) / STATS_SUB_BUCKETS + 4;
+  long long sub = (index - STATS_SUB_BUCKETS) % STATS_SUB_BUCKETS;
+  long long lower = (1LL << msb) | (sub << (msb - 4));
+  return lower + (1LL << (msb - 4)) - 1;
+}
+
+void histogram_add(histogram_t& h, long long ns)
+{
+  if(ns < 0) ns = 0;
+  ++h.buckets[bucket_index(ns)];
+  ++h.count;
+  h.total += ns;
+  if(ns > h.max) h.max = ns;
+}
+
+/* p in [0, 1]. Returns 0 for an empty histogram. */
+long long histogram_percentile(const histogram_t& h, double p)
+{
+  if(h.count == 0) return 0;
+  long long rank = (long long)(p * h.count + 0.5);
+  if(rank < 1) rank = 1;
+  long long seen = 0;
+  for(int i = 0; i < STATS_BUCKETS; ++i){
+    seen += h.buckets[i];
+    if(seen >= rank){
+      long long v = bucket_upper_bound(i);
+      return v < h.max ? v : h.max;
+    }
+  }
+  return h.max;
+}
+
+void stats_init(matchstats_t& stats, int numPlayers)
+{
+  stats.aiLatency.assign(numPlayers, histogram_t());
+  stats.deadlineMisses.assign(numPlayers, 0);
+  stats.lapStart = stats_now_ns();
+}
+
+void stats_begin(matchstats_t& stats)
+{
+  stats.lapStart = stats_now_ns();
+}
+
+/* Adds the time since the previous lap (or stats_begin) to a phase */
+void stats_lap(matchstats_t& stats, statsphase_t phase)
+{
+  long long now = stats_now_ns();
+  histogram_add(stats.phases[phase], now - stats.lapStart);
+  stats.lapStart = now;
+}
+
+/* Records the outcome of the last recv_ipc. Can be called any time before the next one,
+   so the controller does it while the AIs think about the following state. */
+void stats_record_latencies(matchstats_t& stats, const std::vector<childproc_t>& procList)
+{
+  for(int i = 0; i < (int)procList.size(); ++i){
+    if(!procList[i].asked) continue;
+    if(procList[i].latency >= 0)
+      histogram_add(stats.aiLatency[i], procList[i].latency);
+    else
+      ++stats.deadlineMisses[i];
+  }
+}
+
+static void write_histogram(FILE* f, const histogram_t& h)
+{
+  fprintf(f, "{\"count\": %lld, \"mean_ns\": %lld, \"p50_ns\": %lld, \"p90_ns\": %lld, "
+	  "\"p99_ns\": %lld, \"max_ns\": %lld}",
+	  h.count, h.count ? h.total / h.count : 0,
+	  histogram_percentile(h, 0.50), histogram_percentile(h, 0.90),
+	  histogram_percentile(h, 0.99), h.max);
+}
+
+static void write_json_string(FILE* f, const std::string& s)
+{
+  fputc('"', f);
+  for(size_t i = 0; i < s.size(); ++i){
+    unsigned char ch = s[i];
+    if(ch == '"' || ch == '\\') fprintf(f, "\\%c", ch);
+    else if(ch < 0x20) fprintf(f, "\\u%04x", ch);
+    else fputc(ch, f);
+  }
+  fputc('"', f);
+}
+
+/* Writes the summary of a match as JSON. fileName "-" writes to stdout. */
+bool stats_write_json(const matchstats_t& stats, const std::string& fileName,
+		      const std::vector<childproc_t>& procList, int ticks, int winner, uint64_t seed)
+{
+  const char* phaseNames[PhaseCount] = { "render", "send", "recv", "tick" };
+  FILE* f = fileName == "-" ? stdout : fopen(fileName.c_str(), "w");
+  if(!f) return false;
+
+  fprintf(f, "{\n  \"seed\": %llu,\n  \"ticks\": %d,\n  \"winner\": %d,\n  \"phases\": {\n",
+	  (unsigned long long)seed, ticks, winner);
+  for(int p = 0; p < PhaseCount; ++p){
+    fprintf(f, "    \"%s\": ", phaseNames[p]);
+    write_histogram(f, stats.phases[p]);
+    fprintf(f, "%s\n", p + 1 < PhaseCount ? "," : "");
+  }
+  fprintf(f, "  },\n  \"players\": [\n");
+  for(int i = 0; i < (int)procList.size(); ++i){
+    fprintf(f, "    {\"player\": %d, \"path\": ", i + 1);
+    write_json_string(f, procList[i].path);
+    fprintf(f, ", \"protocol\": \"%s\", \"deadline_misses\": %d, \"latency\": ",
+	    snakeProtocolName(procList[i].protocol), stats.deadlineMisses[i]);
+    write_histogram(f, stats.aiLatency[i]);
+    fprintf(f, "}%s\n", i + 1 < (int)procList.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  if(f != stdout) fclose(f);
+  else fflush(f);
+  return true;
+}
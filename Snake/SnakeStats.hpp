@@ -0,0 +1,54 @@
+#ifndef SNAKESTATS_HPP_GUARD
+#define SNAKESTATS_HPP_GUARD
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "shared/SnakeGame.hpp"
+#include "SnakeIPC.hpp"
+
+/* Timing instrumentation for the controllers' game loop */
+
+/* Log-linear histogram of nanosecond timings. Every power of two is split into
+   16 buckets, so the memory use is constant and percentiles are within ~6%. */
+#define STATS_SUB_BUCKETS 16
+#define STATS_BUCKETS (STATS_SUB_BUCKETS * 61)
+
+struct histogram_t
+{
+  histogram_t();
+  long long count;
+  long long total;
+  long long max;
+  std::vector<unsigned int> buckets;
+};
+
+enum statsphase_t
+{
+  PhaseRender = 0,
+  PhaseSend,
+  PhaseRecv,
+  PhaseTick,
+  PhaseCount
+};
+
+struct matchstats_t
+{
+  histogram_t phases[PhaseCount];
+  /* Time from sending a state to an AI until its move arrived, one per player */
+  std::vector<histogram_t> aiLatency;
+  std::vector<int> deadlineMisses;
+  long long lapStart;
+};
+
+/* SnakeStats.cpp */
+long long stats_now_ns();
+void histogram_add(histogram_t& h, long long ns);
+long long histogram_percentile(const histogram_t& h, double p);
+void stats_init(matchstats_t& stats, int numPlayers);
+void stats_begin(matchstats_t& stats);
+void stats_lap(matchstats_t& stats, statsphase_t phase);
+void stats_record_latencies(matchstats_t& stats, const std::vector<childproc_t>& procList);
+bool stats_write_json(const matchstats_t& stats, const std::string& fileName,
+		      const std::vector<childproc_t>& procList, int ticks, int winner, uint64_t seed);
+
+#endif
@@ -0,0 +1,212 @@
+#include <pthread.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include "shared/SnakeGame.hpp"
+#include "SnakeMatch.hpp"
+
+/*
+  Tournament runner. Plays many independent matches between the same plugin AIs
+  (see shared/SnakePlugin.hpp) on a pool of threads, one per core by default, and
+  prints a result line for every match as soon as it is over.
+
+  Every worker owns a deque of matches and its own state. It takes matches from the back
+  of its own deque, and once that runs dry it steals from the front of the others', so a
+  few long games don't leave the other cores idle at the end. Besides the deques, the
+  workers only share the loaded plugins and the output.
+*/
+
+struct tournament_t
+{
+  tournament_t() : seed(0), matchCount(1), threadCount(0), maxTicks(10000){}
+  std::string levelFile;
+  std::vector<std::string> aiPaths;
+  uint64_t seed;
+  int matchCount;
+  int threadCount;
+  int maxTicks;
+  std::vector<std::string> level;
+  std::vector<matchplugin_t> players;
+  /* Draws at index 0, wins of player i at index i + 1 */
+  std::vector<int> results;
+  pthread_mutex_t outputLock;
+};
+
+struct workqueue_t
+{
+  pthread_mutex_t lock;
+  std::deque<int> matches;
+};
+
+struct worker_t
+{
+  int id;
+  pthread_t thread;
+  tournament_t* tournament;
+  std::vector<workqueue_t>* queues;
+  SnakeGameInfo state;
+};
+
+static void print_usage(const char* program)
+{
+  printf("Usage: %s [options] <levelFile> <AI1.so> ... <AIN.so>\n", program);
+  printf("Options:\n");
+  printf("  --matches <n>            Number of matches to play (default: 1)\n");
+  printf("  --threads <n>            Worker threads (default: one per core)\n");
+  printf("  --seed <n>               Seed of the first match, the others follow it (default: from the clock)\n");
+  printf("  --max-ticks <n>          Call a match a draw after this many ticks, 0 for no limit (default: 10000)\n");
+}
+
+/* Options come first, then the level and at least two AIs */
+static bool parse_options(int argc, char* argv[], tournament_t& tournament)
+{
+  int arg = 1;
+  tournament.seed = time(NULL);
+  for(; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg){
+    const char* name = argv[arg];
+    if(arg + 1 >= argc){
+      printf("Missing value for %s\n", name);
+      return false;
+    }
+    const char* value = argv[++arg];
+    if(strcmp(name, "--matches") == 0){
+      tournament.matchCount = atoi(value);
+      if(tournament.matchCount <= 0) return false;
+    } else if(strcmp(name, "--threads") == 0){
+      tournament.threadCount = atoi(value);
+      if(tournament.threadCount <= 0) return false;
+    } else if(strcmp(name, "--seed") == 0){
+      char* end;
+      tournament.seed = strtoull(value, &end, 10);
+      if(*end != '\0' || end == value) return false;
+    } else if(strcmp(name, "--max-ticks") == 0){
+      tournament.maxTicks = atoi(value);
+      if(tournament.maxTicks < 0) return false;
+    } else {
+      printf("Unknown option %s\n", name);
+      return false;
+    }
+  }
+  if(argc - arg < 3) return false;
+  tournament.levelFile = argv[arg++];
+  for(; arg < argc; ++arg)
+    tournament.aiPaths.push_back(argv[arg]);
+  return true;
+}
+
+/* Our own deque from the back, everybody else's from the front. Nothing is ever added
+   once the workers run, so when all deques are empty the tournament is over. */
+static bool take_match(worker_t& worker, int& match)
+{
+  std::vector<workqueue_t>& queues = *worker.queues;
+  int queueCount = queues.size();
+  for(int k = 0; k < queueCount; ++k){
+    workqueue_t& queue = queues[(worker.id + k) % queueCount];
+    bool found;
+    pthread_mutex_lock(&queue.lock);
+    found = !queue.matches.empty();
+    if(found && k == 0){
+      match = queue.matches.back();
+      queue.matches.pop_back();
+    } else if(found){
+      match = queue.matches.front();
+      queue.matches.pop_front();
+    }
+    pthread_mutex_unlock(&queue.lock);
+    if(found) return true;
+  }
+  return false;
+}
+
+static void* worker_main(void* arg)
+{
+  worker_t& worker = *(worker_t*)arg;
+  tournament_t& tournament = *worker.tournament;
+  matchresult_t result;
+
+  while(take_match(worker, result.match)){
+    result.seed = tournament.seed + result.match;
+    run_match(worker.state, tournament.level, tournament.players, tournament.maxTicks, result);
+
+    pthread_mutex_lock(&tournament.outputLock);
+    ++tournament.results[result.winner];
+    printf("match %d seed %llu winner %d ticks %d\n", result.match,
+	   (unsigned long long)result.seed, result.winner, result.ticks);
+    fflush(stdout);
+    pthread_mutex_unlock(&tournament.outputLock);
+  }
+  return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+  tournament_t tournament;
+  SnakeGameInfo levelState;
+  std::vector<workqueue_t> queues;
+  std::vector<worker_t> workers;
+  int playerCount;
+  int started;
+
+  if(!parse_options(argc, argv, tournament)){
+    print_usage(argv[0]);
+    return 0;
+  }
+  if(!snakeInitLevel(tournament.levelFile, levelState)){
+    printf("Couldn't open level \"%s\"\n", tournament.levelFile.c_str());
+    return 1;
+  }
+  tournament.level = levelState.level;
+  playerCount = tournament.aiPaths.size();
+  tournament.players.resize(playerCount);
+  for(int i = 0; i < playerCount; ++i){
+    if(!open_plugin(tournament.aiPaths[i], tournament.players[i])){
+      printf("Tournament AIs must be plugins, see shared/SnakePlugin.hpp.\n");
+      while(i-- > 0) close_plugin(tournament.players[i]);
+      return 1;
+    }
+  }
+  if(tournament.threadCount == 0)
+    tournament.threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+  if(tournament.threadCount > tournament.matchCount)
+    tournament.threadCount = tournament.matchCount;
+  tournament.results.assign(playerCount + 1, 0);
+  pthread_mutex_init(&tournament.outputLock, NULL);
+
+  /* Every worker starts with an equal, contiguous share of the matches */
+  queues.resize(tournament.threadCount);
+  for(int w = 0; w < tournament.threadCount; ++w){
+    pthread_mutex_init(&queues[w].lock, NULL);
+    for(int m = (long long)tournament.matchCount * w / tournament.threadCount;
+	m < (long long)tournament.matchCount * (w + 1) / tournament.threadCount; ++m)
+      queues[w].matches.push_back(m);
+  }
+  printf("Seed %llu\n", (unsigned long long)tournament.seed);
+  workers.resize(tournament.threadCount);
+  for(int w = 0; w < tournament.threadCount; ++w){
+    workers[w].id = w;
+    workers[w].tournament = &tournament;
+    workers[w].queues = &queues;
+  }
+  /* The main thread is worker 0. If some thread can't be started,
+     the others steal its share of the matches. */
+  started = 1;
+  for(int w = 1; w < tournament.threadCount; ++w, ++started)
+    if(pthread_create(&workers[w].thread, NULL, worker_main, &workers[w]) != 0) break;
+  worker_main(&workers[0]);
+  for(int w = 1; w < started; ++w)
+    pthread_join(workers[w].thread, NULL);
+
+  printf("Draws: %d\n", tournament.results[0]);
+  for(int i = 0; i < playerCount; ++i)
+    printf("Player %d (%s) wins: %d\n", i + 1, tournament.aiPaths[i].c_str(), tournament.results[i + 1]);
+
+  for(int w = 0; w < (int)queues.size(); ++w)
+    pthread_mutex_destroy(&queues[w].lock);
+  pthread_mutex_destroy(&tournament.outputLock);
+  for(int i = 0; i < playerCount; ++i)
+    close_plugin(tournament.players[i]);
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <unistd.h>
+#include <SDL/SDL.h>
+#include "SnakeViewer.hpp"
+
+/* The render thread. Draws the newest snapshot whenever there is one, and pumps
+   the SDL events in between, until the user presses Esc. */
+static void* viewer_thread(void* arg)
+{
+  viewer_t& viewer = *(viewer_t*)arg;
+  /* SDL wants the video mode, the drawing and the events on one thread, so all of it happens here */
+  if(!snakeInitGraphics(viewer.slots[0])){
+    __atomic_store_n(&viewer.ready, -1, __ATOMIC_RELEASE);
+    return NULL;
+  }
+  SDL_Surface* vs = viewer.slots[0].vs;
+  __atomic_store_n(&viewer.ready, 1, __ATOMIC_RELEASE);
+
+  while(!snakeShouldQuit()){
+    unsigned int published = __atomic_load_n(&viewer.published, __ATOMIC_ACQUIRE);
+    if(published == viewer.consumed){
+      SDL_Delay(5);
+      continue;
+    }
+    /* When behind, skip straight to the newest snapshot. The renderer only
+       redraws the cells that changed, however far the game has moved on. */
+    SnakeGameInfo& frame = viewer.slots[(published - 1) % VIEWER_SLOTS];
+    frame.vs = vs;
+    snakeRender(frame);
+    __atomic_store_n(&viewer.consumed, published, __ATOMIC_RELEASE);
+  }
+  __atomic_store_n(&viewer.quit, 1, __ATOMIC_RELEASE);
+  snakeDestroyGraphics();
+  return NULL;
+}
+
+/* Opens the window on a new render thread. Returns false if it couldn't. */
+bool viewer_start(viewer_t& viewer, const SnakeGameInfo& state, int renderEvery)
+{
+  for(int i = 0; i < VIEWER_SLOTS; ++i){
+    viewer.slots[i] = state;
+    viewer.slots[i].vs = NULL;
+  }
+  viewer.published = 0;
+  viewer.consumed = 0;
+  viewer.renderEvery = renderEvery > 0 ? renderEvery : 1;
+  viewer.ready = 0;
+  viewer.quit = 0;
+  if(pthread_create(&viewer.thread, NULL, viewer_thread, &viewer) != 0) return false;
+  int ready;
+  while((ready = __atomic_load_n(&viewer.ready, __ATOMIC_ACQUIRE)) == 0)
+    usleep(1000);
+  if(ready < 0){
+    pthread_join(viewer.thread, NULL);
+    return false;
+  }
+  return true;
+}
+
+/* Hands the render thread a snapshot of state, if tick is one that gets rendered.
+   A full ring drops the snapshot, unless force is set; then we wait for a free slot,
+   which is meant for the final state of the game. */
+void viewer_publish(viewer_t& viewer, const SnakeGameInfo& state, int tick, bool force)
+{
+  if(!force && tick % viewer.renderEvery != 0) return;
+  while(viewer.published - __atomic_load_n(&viewer.consumed, __ATOMIC_ACQUIRE) == VIEWER_SLOTS){
+    if(!force || viewer_should_quit(viewer)) return;
+    usleep(1000);
+  }
+  SnakeGameInfo& slot = viewer.slots[viewer.published % VIEWER_SLOTS];
+  /* Only what the renderer looks at. The vectors keep their capacity, so this doesn't allocate. */
+  slot.foodPosition = state.foodPosition;
+  slot.playerCount = state.playerCount;
+  slot.snakes = state.snakes;
+  __atomic_store_n(&viewer.published, viewer.published + 1, __ATOMIC_RELEASE);
+}
+
+bool viewer_should_quit(const viewer_t& viewer)
+{
+  return __atomic_load_n(&viewer.quit, __ATOMIC_ACQUIRE) != 0;
+}
+
+/* The game is over: leave the last state on screen until the user presses Esc */
+void viewer_finish(viewer_t& viewer)
+{
+  pthread_join(viewer.thread, NULL);
+}
@@ -0,0 +1,38 @@
+#ifndef SNAKEVIEWER_HPP_GUARD
+#define SNAKEVIEWER_HPP_GUARD
+#include <pthread.h>
+#include "shared/SnakeGame.hpp"
+
+/*
+  Renders the game on a thread of its own, so watching a game doesn't slow it down.
+
+  The simulation publishes a snapshot of the state every renderEvery ticks into a ring
+  of VIEWER_SLOTS states. There is one producer (the simulation) and one consumer (the
+  render thread), so the ring needs no locks, only the two counters below. If the
+  viewer falls behind, snapshots are dropped rather than making the simulation wait.
+
+  SDL is only ever touched from the render thread: it sets up the video mode, draws,
+  and pumps the events. The simulation learns about Esc through viewer_should_quit.
+*/
+
+#define VIEWER_SLOTS 4
+
+struct viewer_t
+{
+  pthread_t thread;
+  /* Only the food and the snakes are copied in per snapshot; the level is set up once */
+  SnakeGameInfo slots[VIEWER_SLOTS];
+  unsigned int published; /* Snapshots written by the simulation */
+  unsigned int consumed;  /* Snapshots drawn (or skipped) by the render thread */
+  int renderEvery;
+  int ready; /* 0 while the render thread starts up, 1 once it has a window, -1 if it failed */
+  int quit;  /* Set by the render thread when the user presses Esc */
+};
+
+/* SnakeViewer.cpp */
+bool viewer_start(viewer_t& viewer, const SnakeGameInfo& state, int renderEvery);
+void viewer_publish(viewer_t& viewer, const SnakeGameInfo& state, int tick, bool force);
+bool viewer_should_quit(const viewer_t& viewer);
+void viewer_finish(viewer_t& viewer);
+
+#endif
@@ -0,0 +1,52 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include "SnakeGame.hpp"
+#include "SnakeSharedMemory.hpp"
+
+/*
+  Common main loop for the AI programs. Reads the states from the controller,
+  asks AIMove for a move and sends it back.
+  The first state always comes as text on stdin. If the controller offers shared memory
+  the rest of the game goes through it, otherwise we ask for binary deltas on the pipes.
+*/
+
+int main()
+{
+  /* Kept for the whole game, so the decoders can update it in place */
+  SnakeGameInfo state;
+  SnakeStateReader reader(STDIN_FILENO);
+  SnakeShmClient shm;
+  SnakeAIContext ai;
+  Direction d;
+  bool useShm = snakeShmConnect(shm);
+  bool firstMove = true;
+  bool haveState;
+  const char* seed = getenv(SNAKE_SEED_ENV);
+
+  /* For the AI's own random choices */
+  snakeSeedRandom(ai.rng, seed ? strtoull(seed, NULL, 10) : (uint64_t)time(NULL) ^ getpid());
+  ai.data = NULL;
+  ai.release = NULL;
+  std::cout << "PROTOCOL " << snakeProtocolName(useShm ? SnakeProtocolSharedMemory : SnakeProtocolDelta) << '\n';
+  haveState = snakeReadState(reader, state);
+  while(haveState && state.snakes[state.currentPlayer].alive){
+    d = AIMove(state.currentPlayer, state, ai);
+    /* An AI without a move goes right, whichever way the move is sent */
+    if(d == IllegalDirection) d = Right;
+    /* The answer to the first state goes over the pipe, like the protocol request */
+    if(useShm && !firstMove){
+      snakeShmWriteMove(shm, d);
+      haveState = snakeShmReadState(shm, state);
+    } else {
+      std::cout << snakeDirectionToChar(d);
+      std::cout.flush();
+      haveState = useShm ? snakeShmReadState(shm, state) : snakeReadState(reader, state);
+    }
+    firstMove = false;
+  }
+  if(useShm) snakeShmDisconnect(shm);
+  if(ai.release) ai.release(ai.data);
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include "SnakeBitboard.hpp"
+
+static int popcount64(uint64_t x)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* Resizes the board if needed and clears every cell. Keeps the memory between calls. */
+void snakeBitboardInit(SnakeBitboard& board, int width, int height)
+{
+  board.width = width;
+  board.height = height;
+  board.wordsPerRow = (width + 63) / 64;
+  board.words.assign(board.wordsPerRow * height, 0);
+}
+
+int snakeBitboardCount(const SnakeBitboard& board)
+{
+  int count = 0;
+  for(int i = 0; i < (int)board.words.size(); ++i)
+    count += popcount64(board.words[i]);
+  return count;
+}
+
+/* Spreads the bits of seed to the higher and lower bits of the runs of open bits they are in
+   (Kogge-Stone occluded fill, six shift steps each way). seed must be a subset of open. */
+static uint64_t fillRuns(uint64_t seed, uint64_t open)
+{
+  uint64_t up = seed, down = seed;
+  uint64_t upOpen = open, downOpen = open;
+  for(int shift = 1; shift < 64; shift <<= 1){
+    up |= upOpen & (up << shift);
+    upOpen &= upOpen << shift;
+    down |= downOpen & (down >> shift);
+    downOpen &= downOpen >> shift;
+  }
+  return up | down;
+}
+
+/* Fills a row of the flood, left and right as far as its open cells go */
+static void fillRow(uint64_t* row, const uint64_t* open, int wordsPerRow)
+{
+  /* Runs cross word boundaries, so carry them up through the words, then back down */
+  for(int w = 0; w < wordsPerRow; ++w){
+    uint64_t seed = row[w];
+    if(w > 0 && (row[w - 1] >> 63)) seed |= open[w] & 1;
+    if(seed) row[w] = fillRuns(seed, open[w]);
+  }
+  for(int w = wordsPerRow - 2; w >= 0; --w){
+    if(!(row[w + 1] & 1) || (row[w] >> 63) || !(open[w] >> 63)) continue;
+    row[w] = fillRuns(row[w] | ((uint64_t)1 << 63), open[w]);
+  }
+}
+
+/* Pulls the flood in from the neighbouring row, then spreads it along this one */
+static bool spreadFrom(uint64_t* row, const uint64_t* neighbour, const uint64_t* open, int wordsPerRow)
+{
+  bool grew = false;
+  for(int w = 0; w < wordsPerRow; ++w){
+    uint64_t next = row[w] | (neighbour[w] & open[w]);
+    grew |= next != row[w];
+    row[w] = next;
+  }
+  if(!grew) return false;
+  fillRow(row, open, wordsPerRow);
+  return true;
+}
+
+/* Flood fills the open cells 4-connected to [x, y] into filled, and returns how many there are.
+   0 if [x, y] itself isn't open. filled is reused, so repeated fills don't allocate. */
+int snakeBitboardFloodFill(const SnakeBitboard& open, int x, int y, SnakeBitboard& filled)
+{
+  int wordsPerRow = open.wordsPerRow;
+  bool changed = true;
+
+  snakeBitboardInit(filled, open.width, open.height);
+  if(!snakeBitboardTest(open, x, y)) return 0;
+  snakeBitboardSet(filled, x, y);
+  fillRow(&filled.words[y * wordsPerRow], &open.words[y * wordsPerRow], wordsPerRow);
+
+  /* Alternate downward and upward sweeps until neither adds anything. Each sweep carries
+     the flood as far as it can go in its direction, so open areas take a couple of sweeps
+     and only winding corridors need more. */
+  while(changed){
+    changed = false;
+    for(int row = 1; row < open.height; ++row)
+      changed |= spreadFrom(&filled.words[row * wordsPerRow], &filled.words[(row - 1) * wordsPerRow],
+			    &open.words[row * wordsPerRow], wordsPerRow);
+    for(int row = open.height - 2; row >= 0; --row)
+      changed |= spreadFrom(&filled.words[row * wordsPerRow], &filled.words[(row + 1) * wordsPerRow],
+			    &open.words[row * wordsPerRow], wordsPerRow);
+  }
+  return snakeBitboardCount(filled);
+}
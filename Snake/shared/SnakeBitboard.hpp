@@ -0,0 +1,41 @@
+#ifndef SNAKEBITBOARD_HPP_GUARD
+#define SNAKEBITBOARD_HPP_GUARD
+#include <stdint.h>
+#include <vector>
+
+/*
+  One bit per cell of the level, for the AIs' space evaluation.
+  Every row is packed into wordsPerRow 64-bit words, bit x % 64 of word x / 64.
+  Bits past the level width are always 0.
+*/
+struct SnakeBitboard
+{
+  int width;
+  int height;
+  int wordsPerRow;
+  std::vector<uint64_t> words;
+};
+
+inline void snakeBitboardSet(SnakeBitboard& board, int x, int y)
+{
+  board.words[y * board.wordsPerRow + (x >> 6)] |= (uint64_t)1 << (x & 63);
+}
+
+inline void snakeBitboardReset(SnakeBitboard& board, int x, int y)
+{
+  board.words[y * board.wordsPerRow + (x >> 6)] &= ~((uint64_t)1 << (x & 63));
+}
+
+/* Cells outside the board are never set */
+inline bool snakeBitboardTest(const SnakeBitboard& board, int x, int y)
+{
+  if(x < 0 || y < 0 || x >= board.width || y >= board.height) return false;
+  return (board.words[y * board.wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+}
+
+/* SnakeBitboard.cpp */
+void snakeBitboardInit(SnakeBitboard& board, int width, int height);
+int snakeBitboardCount(const SnakeBitboard& board);
+int snakeBitboardFloodFill(const SnakeBitboard& open, int x, int y, SnakeBitboard& filled);
+
+#endif
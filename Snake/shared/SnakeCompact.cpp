@@ -0,0 +1,112 @@
+#include <cstring>
+#include "SnakeCompact.hpp"
+
+static uint16_t pointToCell(const SnakeGameInfo& state, const Point& p)
+{
+  if(p.x < 0 || p.y < 0 || p.x >= state.levelWidth || p.y >= state.levelHeight)
+    return SNAKE_COMPACT_NO_CELL;
+  return p.x + p.y * state.levelWidth;
+}
+
+static Point cellToPoint(const SnakeCompactState& compact, uint16_t cell)
+{
+  if(cell == SNAKE_COMPACT_NO_CELL) return Point(-1, -1);
+  return Point(cell % compact.levelWidth, cell / compact.levelWidth);
+}
+
+/* Returns false if the level or the player count is too large for the fixed size arrays */
+bool snakeCompactFromState(const SnakeGameInfo& state, SnakeCompactState& compact)
+{
+  int cells = state.levelWidth * state.levelHeight;
+  if(cells > SNAKE_COMPACT_MAX_CELLS || state.snakes.size() > SNAKE_COMPACT_MAX_PLAYERS)
+    return false;
+
+  /* Clears the padding and unused parts as well, so equal states compare equal with memcmp */
+  memset(&compact, 0, sizeof(compact));
+  compact.levelWidth = state.levelWidth;
+  compact.levelHeight = state.levelHeight;
+  compact.playerCount = state.snakes.size();
+  compact.currentPlayer = state.currentPlayer;
+  compact.foodCell = pointToCell(state, state.foodPosition);
+  compact.rng = state.rng;
+  for(int y = 0; y < state.levelHeight; ++y)
+    for(int x = 0; x < state.levelWidth; ++x)
+      if(snakeIsCellBorder(x, y, state.level)){
+	int cell = x + y * state.levelWidth;
+	compact.walls[cell >> 6] |= (uint64_t)1 << (cell & 63);
+      }
+
+  int partCount = 0;
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    const SnakeInfo& snake = state.snakes[eachSnake];
+    SnakeCompactSnake& compactSnake = compact.snakes[eachSnake];
+    compactSnake.first = partCount;
+    compactSnake.growCount = snake.growCount;
+    compactSnake.alive = snake.alive;
+    if(!snake.alive) continue;
+    /* Can't happen in a game, see SNAKE_COMPACT_MAX_PARTS, but a state from a file may be anything */
+    if(partCount + snake.bodyParts.size() > SNAKE_COMPACT_MAX_PARTS) return false;
+    compactSnake.length = snake.bodyParts.size();
+    for(int eachBodyPart = 0; eachBodyPart < snake.bodyParts.size(); ++eachBodyPart)
+      compact.parts[partCount++] = pointToCell(state, snake.bodyParts[eachBodyPart]);
+  }
+  compact.partCount = partCount;
+  compact.freeCount = state.freeCells.size();
+  for(int slot = 0; slot < compact.freeCount; ++slot)
+    compact.freeCells[slot] = state.freeCells[slot];
+  return true;
+}
+
+/* Puts the free cell set snakeInitOccupancy built in level order into the stored order.
+   Like snakeRestoreFreeCells, but without building a vector of the order first. */
+static void restoreFreeCells(const SnakeCompactState& compact, SnakeGameInfo& state)
+{
+  if(compact.freeCount != state.freeCells.size()) return;
+  for(int slot = 0; slot < compact.freeCount; ++slot){
+    int index = compact.freeCells[slot];
+    if(index >= (int)state.occupancy.size()){
+      snakeInitOccupancy(state);
+      return;
+    }
+    state.freeCells[slot] = index;
+    state.occupancy[index].freeSlot = slot;
+  }
+}
+
+/* Rebuilds the level, the snakes, the occupancy grid and the free cell set. The buffers state
+   already has are reused, so converting into the same state over and over doesn't allocate.
+   Dead snakes come back without a body. state.vs is left alone. */
+void snakeCompactToState(const SnakeCompactState& compact, SnakeGameInfo& state)
+{
+  int playerCount = compact.playerCount;
+  state.levelWidth = compact.levelWidth;
+  state.levelHeight = compact.levelHeight;
+  state.playerCount = playerCount;
+  state.currentPlayer = compact.currentPlayer;
+  state.foodPosition = cellToPoint(compact, compact.foodCell);
+  state.rng = compact.rng;
+
+  state.level.resize(compact.levelHeight);
+  for(int y = 0; y < compact.levelHeight; ++y){
+    std::string& row = state.level[y];
+    row.resize(compact.levelWidth);
+    for(int x = 0; x < compact.levelWidth; ++x)
+      row[x] = snakeCompactIsWall(compact, x + y * compact.levelWidth) ? 'x' : ' ';
+  }
+
+  state.snakes.resize(playerCount);
+  for(int eachSnake = 0; eachSnake < playerCount; ++eachSnake){
+    const SnakeCompactSnake& compactSnake = compact.snakes[eachSnake];
+    SnakeInfo& snake = state.snakes[eachSnake];
+    /* Same capacity snakeInitSnakes reserves, so the body never grows during a game */
+    snake.bodyParts.reserve(compact.levelWidth * compact.levelHeight);
+    snake.bodyParts.clear();
+    for(int eachBodyPart = 0; eachBodyPart < compactSnake.length; ++eachBodyPart)
+      snake.bodyParts.pushTail(cellToPoint(compact, compact.parts[compactSnake.first + eachBodyPart]));
+    snake.alive = compactSnake.alive != 0;
+    snake.growCount = compactSnake.growCount;
+  }
+  snakeInitOccupancy(state);
+  restoreFreeCells(compact, state);
+  state.hash = snakeComputeHash(state);
+}
@@ -0,0 +1,66 @@
+#ifndef SNAKECOMPACT_HPP_GUARD
+#define SNAKECOMPACT_HPP_GUARD
+#include <stdint.h>
+#include "SnakeGame.hpp"
+
+/*
+  The whole game in one fixed size, trivially copyable struct, for AIs that clone
+  a lot of states (rollouts) or keep a lot of them around. There are no pointers in it,
+  so a copy is a single memcpy and a state can be written to a file as it is.
+
+  Cells are 16-bit indices x + y * levelWidth. The bodies of the live snakes are stored
+  back to back in parts, each one from head to tail, starting at SnakeCompactSnake::first.
+  Dead snakes keep no parts: they are no obstacle and not part of the hash, and keeping
+  every body a snake ever had would make the bound on parts players times cells.
+  The free cell set is stored in its order, since food is placed by position in it;
+  a state plays on after a round trip exactly like the original game.
+  Levels with more than SNAKE_COMPACT_MAX_CELLS cells or more than SNAKE_COMPACT_MAX_PLAYERS
+  players don't fit, and snakeCompactFromState refuses them.
+  SnakeReplay --verify takes every keyframe through a round trip, so a field the game
+  state gains but this struct doesn't shows up there.
+*/
+
+#define SNAKE_COMPACT_MAX_CELLS 4096 /* 64x64 */
+#define SNAKE_COMPACT_MAX_PLAYERS 8
+/* A live snake only moves onto a clear cell, growing or not, so the live snakes never fill more
+   than the level's cells. Snakes the level had no room for at the start sit outside of it,
+   on one part each. */
+#define SNAKE_COMPACT_MAX_PARTS (SNAKE_COMPACT_MAX_CELLS + SNAKE_COMPACT_MAX_PLAYERS)
+#define SNAKE_COMPACT_NO_CELL 0xffff /* Food or body parts outside the map */
+
+struct SnakeCompactSnake
+{
+  uint16_t first;  /* Index of the head in SnakeCompactState::parts */
+  uint16_t length;
+  uint16_t growCount;
+  uint8_t alive;
+  uint8_t pad;
+};
+
+struct SnakeCompactState
+{
+  uint16_t levelWidth;
+  uint16_t levelHeight;
+  uint8_t playerCount;
+  uint8_t currentPlayer;
+  uint16_t foodCell;
+  uint16_t partCount; /* Used entries of parts */
+  uint16_t freeCount; /* Used entries of freeCells */
+  uint16_t pad[2];
+  SnakeRandom rng;
+  uint64_t walls[SNAKE_COMPACT_MAX_CELLS / 64]; /* Bit i % 64 of word i / 64 is set for walls */
+  SnakeCompactSnake snakes[SNAKE_COMPACT_MAX_PLAYERS];
+  uint16_t parts[SNAKE_COMPACT_MAX_PARTS];
+  uint16_t freeCells[SNAKE_COMPACT_MAX_CELLS]; /* SnakeGameInfo::freeCells, in the same order */
+};
+
+inline bool snakeCompactIsWall(const SnakeCompactState& compact, int cell)
+{
+  return (compact.walls[cell >> 6] >> (cell & 63)) & 1;
+}
+
+/* SnakeCompact.cpp */
+bool snakeCompactFromState(const SnakeGameInfo& state, SnakeCompactState& compact);
+void snakeCompactToState(const SnakeCompactState& compact, SnakeGameInfo& state);
+
+#endif
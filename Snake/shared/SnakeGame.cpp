@@ -0,0 +1,200 @@
+#include <fstream>
+#include <iostream>
+#include "SnakeGame.hpp"
+
+bool snakeInitLevel(const std::string& levelFile, SnakeGameInfo& state)
+{
+  std::ifstream strm(levelFile.c_str());
+  if(!strm.is_open()) return false;
+  std::string line;
+  while(std::getline(strm, line)){
+    state.level.push_back(line);
+  }
+  state.levelWidth = state.level[0].length();
+  state.levelHeight = state.level.size();
+  return true;
+}
+
+void snakeInitSnakes(SnakeGameInfo& state, int playerCount)
+{
+    /* IsCellClear checks whether the rpart position collides with
+     other snakes, so init state.snakes[i].parts[j] to be outside the map bounds to avoid this. */
+  Point point_outside_map(-1, -1);
+  SnakeInfo tmpSnake;
+
+  state.playerCount = playerCount;
+  state.currentPlayer = 0;
+  /* A snake can never be longer than the level is large, so reserve that up front
+     and the body buffer never has to grow during the game. */
+  tmpSnake.bodyParts.reserve(state.levelWidth * state.levelHeight);
+  /* TODO: Fix so that we can have longer snakes at the beginning of the level.
+     Currently we start with snakes of 1 in length. We rather want three-celled snakes. */
+  tmpSnake.bodyParts.pushTail(point_outside_map);
+  tmpSnake.alive = true;
+  /* Whenever growCount > 0, we move the snake body without updating the tail,
+     and decrement growCount accordingly. */
+  tmpSnake.growCount = 0;
+
+  state.snakes.resize(playerCount);
+  /* Initialize all snakes to be outside the map */
+  for(int eachSnake = 0; eachSnake < playerCount; ++eachSnake)
+    state.snakes[eachSnake] = tmpSnake;
+  snakeInitOccupancy(state);
+
+  for(int eachSnake = 0; eachSnake < playerCount; ++eachSnake){
+    Point rpart;
+    /* A level without room for everybody leaves the rest of the snakes outside the map */
+    if(!snakeRandomFreeCell(state, rpart)) break;
+    state.snakes[eachSnake].bodyParts[0] = rpart;
+    snakeOccupyCell(state, rpart, eachSnake);
+  }
+  /* No food yet, snakeInitFood places it */
+  state.foodPosition = point_outside_map;
+  state.hash = snakeComputeHash(state);
+}
+
+void snakeInitFood(SnakeGameInfo& state)
+{
+  snakeUpdateFood(state);
+}
+
+
+/* Called only if the snake doesn't collide with anything */
+void snakeUpdateSnake(SnakeGameInfo& state, int player, Direction direction, SnakeUndo* undo)
+{
+  SnakeInfo& snake = state.snakes[player];
+  Point newHead = snakeComputeNewHead(snake.bodyParts.head(), direction);
+  bool grew = snakeIsSnakeGrowing(snake);
+  state.hash ^= snakeZobristPointKey(state, SnakeZobristHead, player, snake.bodyParts.head());
+  state.hash ^= snakeZobristPointKey(state, SnakeZobristHead, player, newHead);
+  state.hash ^= snakeZobristPointKey(state, SnakeZobristBody, player, newHead);
+  if(undo){
+    undo->snakes[player].moved = true;
+    undo->snakes[player].grew = grew;
+    undo->snakes[player].tail = snake.bodyParts.tail();
+  }
+  if(grew){
+    /* The tail stays put, so the snake becomes one part longer */
+    snake.bodyParts.pushHead(newHead);
+    state.hash ^= snakeZobristKey(SnakeZobristGrow, player, snake.growCount);
+    --snake.growCount;
+    state.hash ^= snakeZobristKey(SnakeZobristGrow, player, snake.growCount);
+  } else {
+    /* The tail moves away from its cell */
+    snakeVacateCell(state, snake.bodyParts.tail(), undo);
+    state.hash ^= snakeZobristPointKey(state, SnakeZobristBody, player, snake.bodyParts.tail());
+    snake.bodyParts.advance(newHead);
+  }
+  snakeOccupyCell(state, newHead, player, undo);
+}
+
+/* Food goes on a random clear cell. If the snakes have filled up the level,
+   the food is parked outside the map until a cell frees up again. */
+void snakeUpdateFood(SnakeGameInfo& state)
+{
+  Point point_outside_map(-1, -1);
+  state.hash ^= snakeZobristPointKey(state, SnakeZobristFood, 0, state.foodPosition);
+  if(!snakeRandomFreeCell(state, state.foodPosition))
+    state.foodPosition = point_outside_map;
+  state.hash ^= snakeZobristPointKey(state, SnakeZobristFood, 0, state.foodPosition);
+}
+
+/* Returns the winning player id. Every change is logged to undo, unless it is NULL. */
+static int gameTick(SnakeGameInfo& state, const std::vector<Direction>& input, SnakeUndo* undo)
+{
+  int aliveCount = 0;
+  int winnerSnake = 0;
+
+  /* Kill snakes with illegal input */
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    if(input[eachSnake] == IllegalDirection && state.snakes[eachSnake].alive){
+      state.snakes[eachSnake].alive = false;
+      snakeRemoveSnake(state, eachSnake, undo);
+    }
+  }
+  /* Update to new positions */
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    if(state.snakes[eachSnake].alive){
+      snakeUpdateSnake(state, eachSnake, input[eachSnake], undo);
+    }
+  }
+  /* With the new positions, cull out any dead snakes that collided */
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    if(state.snakes[eachSnake].alive){
+      Point head = state.snakes[eachSnake].bodyParts[0];
+      state.snakes[eachSnake].alive = snakeIsCellClear(head.x, head.y, eachSnake, state);
+      /* A dead snake is ignored by the collision checks of the snakes after it */
+      if(!state.snakes[eachSnake].alive)
+	snakeRemoveSnake(state, eachSnake, undo);
+      ++aliveCount;
+      winnerSnake = eachSnake;
+    }
+  }
+
+  /* Now only the alive updated snakes are left. Check for winners, and if someone grabbed the food. */
+  if(aliveCount == 1) return winnerSnake + 1;
+  else if(aliveCount == 0) return 0; /* 0 == draw */
+
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    if(state.snakes[eachSnake].alive){
+      Point head = state.snakes[eachSnake].bodyParts[0];
+      /* Food makes the snake tail grow for 'growCount' turns */
+      if(snakeIsCellFood(head.x, head.y, state.foodPosition)){
+	state.hash ^= snakeZobristKey(SnakeZobristGrow, eachSnake, state.snakes[eachSnake].growCount);
+	state.snakes[eachSnake].growCount += 3;
+	state.hash ^= snakeZobristKey(SnakeZobristGrow, eachSnake, state.snakes[eachSnake].growCount);
+	snakeUpdateFood(state);
+      }
+    }
+  }
+  if(state.foodPosition.x < 0)
+    snakeUpdateFood(state);
+  return -1; /* -1 = continue */
+}
+
+
+int snakeGameTick(SnakeGameInfo& state, const std::vector<Direction>& input)
+{
+  return gameTick(state, input, NULL);
+}
+
+/* Same as snakeGameTick, but records everything it changes in undo, so a search
+   can step the game forward and back without copying the whole state. */
+int snakeMakeTick(SnakeGameInfo& state, const std::vector<Direction>& input, SnakeUndo& undo)
+{
+  /* Enough room for every snake to move and every body part on the level to be vacated */
+  int maxCellChanges = state.levelWidth * state.levelHeight + 3 * state.playerCount;
+  if((int)undo.cells.capacity() < maxCellChanges) undo.cells.reserve(maxCellChanges);
+  undo.cells.clear();
+  undo.snakes.resize(state.snakes.size());
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    undo.snakes[eachSnake].alive = state.snakes[eachSnake].alive;
+    undo.snakes[eachSnake].growCount = state.snakes[eachSnake].growCount;
+    undo.snakes[eachSnake].moved = false;
+  }
+  undo.foodPosition = state.foodPosition;
+  undo.rng = state.rng;
+  undo.hash = state.hash;
+  return gameTick(state, input, &undo);
+}
+
+/* Put the state back to what it was before the snakeMakeTick that filled undo.
+   Ticks have to be unmade in the reverse order they were made. */
+void snakeUnmakeTick(SnakeGameInfo& state, const SnakeUndo& undo)
+{
+  for(int eachChange = (int)undo.cells.size() - 1; eachChange >= 0; --eachChange)
+    snakeUndoCell(state, undo.cells[eachChange]);
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    SnakeInfo& snake = state.snakes[eachSnake];
+    const SnakeUndoSnake& saved = undo.snakes[eachSnake];
+    if(saved.moved){
+      if(saved.grew) snake.bodyParts.popHead();
+      else snake.bodyParts.retreat(saved.tail);
+    }
+    snake.alive = saved.alive;
+    snake.growCount = saved.growCount;
+  }
+  state.foodPosition = undo.foodPosition;
+  state.rng = undo.rng;
+  state.hash = undo.hash;
+}
@@ -1,5 +1,6 @@
 #ifndef SNAKEGAME_HPP_GUARD
 #define SNAKEGAME_HPP_GUARD
+#include <stdint.h>
 #include <vector>
 #include <string>
 
@@ -19,13 +20,93 @@ struct Point
   int x,y;
 };
 
+/* Snake body kept in a ring buffer, so that moving or growing the snake never
+   shifts the whole body. Index 0 is the head and size() - 1 is the tail.
+   The capacity is a power of two, and is normally reserved up front for the
+   whole level so the buffer never reallocates during a game. */
+class SnakeBody
+{
+public:
+  SnakeBody() : first(0), length(0), mask(-1){}
+
+  int size() const { return length; }
+  int capacity() const { return mask + 1; }
+  const Point& operator[](int i) const { return parts[(first + i) & mask]; }
+  Point& operator[](int i) { return parts[(first + i) & mask]; }
+  const Point& head() const { return (*this)[0]; }
+  const Point& tail() const { return (*this)[length - 1]; }
+
+  void clear() { first = 0; length = 0; }
+  void reserve(int minCapacity);
+  /* Grow by one: the new head is added in front of the old one */
+  void pushHead(const Point& p)
+  {
+    if(length == capacity()) reserve(length + 1);
+    first = (first - 1) & mask;
+    parts[first] = p;
+    ++length;
+  }
+  /* Append behind the tail. Used when building a body head-to-tail. */
+  void pushTail(const Point& p)
+  {
+    if(length == capacity()) reserve(length + 1);
+    parts[(first + length) & mask] = p;
+    ++length;
+  }
+  void popHead() { first = (first + 1) & mask; --length; }
+  void popTail() { --length; }
+  /* Move one step: push a new head and drop the tail in one go */
+  void advance(const Point& newHead)
+  {
+    first = (first - 1) & mask;
+    parts[first] = newHead;
+  }
+  /* Undo advance: drop the head and put the old tail back behind the body */
+  void retreat(const Point& oldTail)
+  {
+    first = (first + 1) & mask;
+    parts[(first + length - 1) & mask] = oldTail;
+  }
+
+private:
+  std::vector<Point> parts;
+  int first;
+  int length;
+  int mask;
+};
+
 struct SnakeInfo
 {
-  std::vector<Point> bodyParts;
+  SnakeBody bodyParts;
   bool alive;
   int growCount;
 };
 
+/* One entry per level cell, updated as the snakes move so that
+   collision checks don't have to walk the snake bodies. */
+struct SnakeCell
+{
+  SnakeCell() : count(0), owner(-1), freeSlot(-1){}
+  int count; /* Number of live body parts on this cell */
+  int owner; /* Player id of the last body part placed here, -1 when empty */
+  int freeSlot; /* Position in SnakeGameInfo::freeCells, -1 for walls and snake cells */
+};
+
+/* xoshiro256** generator. Every match owns one and seeds it with snakeSeedRandom,
+   so matches can run side by side and any match can be replayed from its seed. */
+struct SnakeRandom
+{
+  uint64_t s[4];
+};
+
+/* The controller hands every AI its own seed in this environment variable */
+#define SNAKE_SEED_ENV "SNAKE_SEED"
+/* and, when the controller has a per-move deadline, the deadline in milliseconds in this one */
+#define SNAKE_DEADLINE_ENV "SNAKE_DEADLINE_MS"
+/* Nodes a searching AI may spend per move instead of watching the clock, so that it plays
+   the same moves on any machine. Passed on from the controller's own environment. */
+#define SNAKE_NODE_BUDGET_ENV "SNAKE_NODE_BUDGET"
+
 /* Use SDL_Surface as a pimpl */
 struct SDL_Surface;
 
@@ -33,14 +114,64 @@ struct SnakeGameInfo
 {
   std::vector<std::string> level;
   std::vector<SnakeInfo> snakes;
+  /* levelWidth * levelHeight cells, indexed by x + y * levelWidth */
+  std::vector<SnakeCell> occupancy;
+  /* Every cell that is neither a wall nor a snake, in no particular order.
+     Kept up to date together with the occupancy grid, so a random clear cell is a single draw. */
+  std::vector<int> freeCells;
   Point foodPosition;
   int playerCount;
   int currentPlayer;
   int levelWidth;
   int levelHeight;
+  /* Used for food and snake placement. The decoders leave it alone. */
+  SnakeRandom rng;
+  /* Zobrist key of the position, see snakeComputeHash. Kept up to date by the game
+     and recomputed by the decoders. */
+  uint64_t hash;
   SDL_Surface* vs;
 };
 
+/* One change to the occupancy grid, see SnakeUndo */
+struct SnakeUndoCell
+{
+  int index;    /* Cell index into SnakeGameInfo::occupancy */
+  int owner;    /* Owner of the cell before the change */
+  int freeSlot; /* Slot the cell left (occupied) or took (vacated) in freeCells, -1 if none */
+  bool occupied; /* true for snakeOccupyCell, false for snakeVacateCell */
+};
+
+struct SnakeUndoSnake
+{
+  bool alive;
+  int growCount;
+  bool moved;
+  bool grew;  /* Moved with pushHead rather than advance */
+  Point tail; /* Tail before an advance */
+};
+
+/* Everything snakeMakeTick changed, so snakeUnmakeTick can put the state back exactly,
+   including the rng and the order of the free cell set. Keep one per search ply: the
+   buffers are kept from one tick to the next, so after the first tick nothing allocates. */
+struct SnakeUndo
+{
+  std::vector<SnakeUndoSnake> snakes;
+  std::vector<SnakeUndoCell> cells;
+  Point foodPosition;
+  SnakeRandom rng;
+  uint64_t hash;
+};
+
+/* The features of a position that get their own Zobrist key, see snakeZobristKey */
+enum SnakeZobristFeature
+{
+  SnakeZobristBody = 0, /* A body part (the head included) of a live snake on a cell */
+  SnakeZobristHead = 1, /* The head of a live snake on a cell */
+  SnakeZobristGrow = 2, /* The growCount of a live snake */
+  SnakeZobristDead = 3, /* A dead snake */
+  SnakeZobristFood = 4  /* The food on a cell, only while it is on the map */
+};
+
 enum Direction
 {
   Up = 0,
@@ -50,21 +181,98 @@ enum Direction
   IllegalDirection = 4
 };
 
+/* Wire formats between the controller and the AIs. Every AI is sent text states
+   until it asks for another format by writing a "PROTOCOL <name>" line ahead of
+   its first move. All states after that first move use the requested format.
+   With SnakeProtocolDelta the AI gets one binary full state, and after that only
+   binary deltas that have to be applied to the state it already has.
+   SnakeProtocolSharedMemory moves the states and moves off the pipes entirely,
+   see SnakeSharedMemory.hpp. SnakeProtocolPlugin isn't a wire format and can't be
+   asked for: it marks AIs loaded as shared objects and called in-process, see SnakePlugin.hpp. */
+enum SnakeProtocol
+{
+  SnakeProtocolText = 0,
+  SnakeProtocolBinary = 1,
+  SnakeProtocolDelta = 2,
+  SnakeProtocolSharedMemory = 3,
+  SnakeProtocolPlugin = 4
+};
+
+enum SnakeMessageType
+{
+  SnakeMessageFullState = 0,
+  SnakeMessageDelta = 1
+};
+
+#define SNAKE_BINARY_MAGIC "SNKB"
+#define SNAKE_BINARY_VERSION 1
+#define SNAKE_BINARY_HEADER_SIZE 12
+#define SNAKE_BINARY_MAX_PAYLOAD (64 * 1024 * 1024)
+
+/* Outcome of parsing a text state */
+enum SnakeParseStatus
+{
+  SnakeParseOk = 0,
+  SnakeParseTruncated = 1, /* The input ends before the state does */
+  SnakeParseMalformed = 2, /* Something other than a number where one belongs, a row of the wrong width, or bytes left over */
+  SnakeParseOutOfRange = 3 /* A number too large for an int, or a count or index the state can't have */
+};
+
+/* Reads the states sent by the controller from a file descriptor. The buffers are
+   kept from one state to the next, so in the steady state reading doesn't allocate. */
+struct SnakeStateReader
+{
+  SnakeStateReader(int _fd);
+  int fd;
+  std::vector<char> buffer;
+  size_t begin; /* Unread bytes are buffer[begin, end) */
+  size_t end;
+};
+
 /* SnakeMisc.cpp */
-int randRange(int min, int max);
-Point randPoint(int xmin, int xmax, int ymin, int ymax);
+void snakeSeedRandom(SnakeRandom& rng, uint64_t seed);
+uint64_t snakeRandomNext(SnakeRandom& rng);
+uint64_t snakePlayerSeed(uint64_t matchSeed, int player);
+int randRange(SnakeRandom& rng, int min, int max);
+Point randPoint(SnakeRandom& rng, int xmin, int xmax, int ymin, int ymax);
 
-Direction snakeGenerateRandomDirection();
+Direction snakeGenerateRandomDirection(SnakeRandom& rng);
+char snakeDirectionToChar(Direction direction);
+Direction snakeCharToDirection(char ch);
 Point snakeComputeNewHead(Point head, Direction direction);
 bool snakeIsCellBorder(int x, int y, const std::vector<std::string>& level);
 bool snakeIsCellFood(int x, int y, const Point& food);
-bool snakeIsCellSnake(int x, int y, int snakeToSkip, const std::vector<SnakeInfo>& snakes);
+bool snakeIsCellSnake(int x, int y, int snakeToSkip, const SnakeGameInfo& state);
 bool snakeIsCellClear(int x, int y, int snakeToSkip, const SnakeGameInfo& state);
 bool snakeIsSnakeGrowing(SnakeInfo& snake);
+void snakeInitOccupancy(SnakeGameInfo& state);
+bool snakeRestoreFreeCells(SnakeGameInfo& state, const std::vector<int>& order);
+void snakeOccupyCell(SnakeGameInfo& state, const Point& p, int player, SnakeUndo* undo = NULL);
+void snakeVacateCell(SnakeGameInfo& state, const Point& p, SnakeUndo* undo = NULL);
+void snakeRemoveSnake(SnakeGameInfo& state, int player, SnakeUndo* undo = NULL);
+void snakeUndoCell(SnakeGameInfo& state, const SnakeUndoCell& change);
+bool snakeRandomFreeCell(SnakeGameInfo& state, Point& p);
+uint64_t snakeZobristKey(SnakeZobristFeature feature, int player, int value);
+uint64_t snakeZobristPointKey(const SnakeGameInfo& state, SnakeZobristFeature feature, int player, const Point& p);
+uint64_t snakeComputeHash(const SnakeGameInfo& state);
+
+/* What an AI keeps from one move to the next. SnakeAIMain.cpp and SnakePluginExport.cpp
+   hold one per AI for the whole game. */
+struct SnakeAIContext
+{
+  SnakeRandom rng; /* For the AI's own random choices */
+  /* Anything else the AI wants to keep, NULL until it sets it. If the AI sets release
+     too, it is called on data when the game is over. */
+  void* data;
+  void (*release)(void* data);
+};
+
+/* Implemented by each AI, and driven by SnakeAIMain.cpp or, in-process, by SnakePluginExport.cpp.
+   The state must not be changed. */
+Direction AIMove(int player, const SnakeGameInfo& state, SnakeAIContext& ai);
 
-/* SnakeAI.cpp
-Direction AIMove(int player, SnakeGameInfo& state);
-*/
+/* Length of a tick when the game is watched in real time */
+#define SNAKE_TICK_MS 50
 
 /* SnakeRenderer.cpp */
 bool snakeInitGraphics(SnakeGameInfo& state);
@@ -74,15 +282,28 @@ bool snakeShouldQuit();
 
 /* SnakeSerialization.cpp */
 void snakeSerializeStateToStream(const SnakeGameInfo& state, std::string& strm);
+void snakeSerializeSharedStateToStream(const SnakeGameInfo& state, std::string& strm);
 bool snakeSerializeStreamToState(SnakeGameInfo& state, const std::vector<std::string>& strm);
+SnakeParseStatus snakeParseTextState(SnakeGameInfo& state, const char* text, size_t length);
+void snakeSerializeStateToBinary(const SnakeGameInfo& state, std::string& strm);
+void snakeSerializeDeltaToBinary(const SnakeGameInfo& state, std::string& strm);
+bool snakeSerializeBinaryToState(SnakeGameInfo& state, const char* strm, int length);
+void snakeBinarySetPlayer(char* header, int currentPlayer);
+int snakeBinaryMessageLength(const char* header);
+int snakeBinaryMaxMessageLength(const SnakeGameInfo& state);
+bool snakeReadState(SnakeStateReader& reader, SnakeGameInfo& state);
+const char* snakeProtocolName(SnakeProtocol protocol);
+bool snakeParseProtocolName(const std::string& name, SnakeProtocol& protocol);
 
 /* SnakeGame.cpp  */
 bool snakeInitLevel(const std::string& levelFile, SnakeGameInfo& state);
 void snakeInitSnakes(SnakeGameInfo& state, int playerCount);
 void snakeInitFood(SnakeGameInfo& state);
-void snakeUpdateSnake(SnakeInfo& snake, Direction direction);
+void snakeUpdateSnake(SnakeGameInfo& state, int player, Direction direction, SnakeUndo* undo = NULL);
 void snakeUpdateFood(SnakeGameInfo& state);
 int snakeGameTick(SnakeGameInfo& state, const std::vector<Direction>& input);
+int snakeMakeTick(SnakeGameInfo& state, const std::vector<Direction>& input, SnakeUndo& undo);
+void snakeUnmakeTick(SnakeGameInfo& state, const SnakeUndo& undo);
 
 #endif
 
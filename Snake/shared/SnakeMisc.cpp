@@ -1,28 +1,67 @@
-#include <cstdlib>
 #include "SnakeGame.hpp"
 
-/* Random integer in a range */
-int randRange(int min, int max)
+static uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+/* Expands the seed with splitmix64, so close seeds still give unrelated streams
+   and the state is never all zero */
+void snakeSeedRandom(SnakeRandom& rng, uint64_t seed)
+{
+  for(int i = 0; i < 4; ++i){
+    uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    rng.s[i] = z ^ (z >> 31);
+  }
+}
+
+uint64_t snakeRandomNext(SnakeRandom& rng)
+{
+  uint64_t* s = rng.s;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+/* The seed every AI gets for its own random choices, derived from the match seed */
+uint64_t snakePlayerSeed(uint64_t matchSeed, int player)
+{
+  /* Scrambled, so the AI seeds of one match don't line up with the match seeds
+     of the next one when a tournament uses consecutive seeds */
+  return matchSeed ^ ((uint64_t)(player + 1) * 0x9e3779b97f4a7c15ULL);
+}
+
+/* Random integer in the inclusive range [min, max] */
+int randRange(SnakeRandom& rng, int min, int max)
 {
   double dmin, dmax, drand;
-  drand = (double)rand() / (double)RAND_MAX;
+  /* The top 53 bits as a double in [0, 1), so every integer in the range gets an equal share */
+  drand = (double)(snakeRandomNext(rng) >> 11) * (1.0 / 9007199254740992.0);
   dmin = (double)min;
   dmax = (double)max;
 
-  return dmin + drand*(dmax - dmin);
+  return dmin + drand*(dmax - dmin + 1.0);
 }
 
-Point randPoint(int xmin, int xmax, int ymin, int ymax)
+Point randPoint(SnakeRandom& rng, int xmin, int xmax, int ymin, int ymax)
 {
   Point p;
-  p.x = randRange(xmin, xmax);
-  p.y = randRange(ymin, ymax);
+  p.x = randRange(rng, xmin, xmax);
+  p.y = randRange(rng, ymin, ymax);
   return p;
 }
 
-Direction snakeGenerateRandomDirection()
+Direction snakeGenerateRandomDirection(SnakeRandom& rng)
 {
-  int d = randRange(0, 3);
+  int d = randRange(rng, 0, 3);
   switch(d){
     case 0: return Up;
     case 1: return Down;
@@ -31,6 +70,29 @@ Direction snakeGenerateRandomDirection()
   return Right;
 }
 
+/* Moves are sent as a single character */
+char snakeDirectionToChar(Direction direction)
+{
+  switch(direction){
+  case Up: return 'u';
+  case Down: return 'd';
+  case Left: return 'l';
+  case Right: return 'r';
+  default: return 'x';
+  }
+}
+
+Direction snakeCharToDirection(char ch)
+{
+  switch(ch){
+  case 'u': return Up;
+  case 'd': return Down;
+  case 'l': return Left;
+  case 'r': return Right;
+  }
+  return IllegalDirection;
+}
+
 Point snakeComputeNewHead(Point head, Direction direction)
 {
   Point p;
@@ -70,27 +132,221 @@ bool snakeIsCellFood(int x, int y, const Point& food)
 }
 
 /* Is cell [x, y] on the board a snake ? */
-bool snakeIsCellSnake(int x, int y, int snakeToSkip, const std::vector<SnakeInfo>& snakes)
-{
-  int s;
-  Point p(x,y);
-  for(int eachSnake = 0; eachSnake < (int)snakes.size(); ++eachSnake){
-    /* Don't incorrectly compare the snake's head to itself */
-    if(eachSnake == snakeToSkip) s = 1;
-    else s = 0;
-    for(int eachBodyPart = s; eachBodyPart < (int)snakes[eachSnake].bodyParts.size(); ++eachBodyPart){
-      if(snakes[eachSnake].bodyParts[eachBodyPart] == p && snakes[eachSnake].alive) return true;
-    }
-  }
-  return false;
+bool snakeIsCellSnake(int x, int y, int snakeToSkip, const SnakeGameInfo& state)
+{
+  if(x < 0 || y < 0 || x >= state.levelWidth || y >= state.levelHeight) return false;
+  int count = state.occupancy[x + y * state.levelWidth].count;
+  /* Don't incorrectly compare the snake's head to itself */
+  if(snakeToSkip >= 0 && state.snakes[snakeToSkip].alive &&
+     state.snakes[snakeToSkip].bodyParts[0] == Point(x, y))
+    --count;
+  return count > 0;
 }
 
 bool snakeIsCellClear(int x, int y, int snakeToSkip, const SnakeGameInfo& state)
 {
-  return !snakeIsCellBorder(x, y, state.level) && !snakeIsCellSnake(x, y, snakeToSkip, state.snakes);
+  return !snakeIsCellBorder(x, y, state.level) && !snakeIsCellSnake(x, y, snakeToSkip, state);
 }
 
 bool snakeIsSnakeGrowing(SnakeInfo& snake)
 {
   return snake.growCount > 0;
 }
+
+static void addFreeCell(SnakeGameInfo& state, int index)
+{
+  state.occupancy[index].freeSlot = state.freeCells.size();
+  state.freeCells.push_back(index);
+}
+
+/* Swap the last free cell into the removed one's slot */
+static void removeFreeCell(SnakeGameInfo& state, int index)
+{
+  int slot = state.occupancy[index].freeSlot;
+  int last = state.freeCells.back();
+  state.freeCells[slot] = last;
+  state.occupancy[last].freeSlot = slot;
+  state.freeCells.pop_back();
+  state.occupancy[index].freeSlot = -1;
+}
+
+/* Rebuild the occupancy grid and the free cell set from scratch from the level and the live snakes */
+void snakeInitOccupancy(SnakeGameInfo& state)
+{
+  state.occupancy.assign(state.levelWidth * state.levelHeight, SnakeCell());
+  state.freeCells.clear();
+  state.freeCells.reserve(state.levelWidth * state.levelHeight);
+  for(int y = 0; y < state.levelHeight; ++y)
+    for(int x = 0; x < state.levelWidth; ++x)
+      if(!snakeIsCellBorder(x, y, state.level))
+	addFreeCell(state, x + y * state.levelWidth);
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    if(!state.snakes[eachSnake].alive) continue;
+    for(int eachBodyPart = 0; eachBodyPart < (int)state.snakes[eachSnake].bodyParts.size(); ++eachBodyPart)
+      snakeOccupyCell(state, state.snakes[eachSnake].bodyParts[eachBodyPart], eachSnake);
+  }
+}
+
+/* Puts the free cell set in the given order, which has to hold exactly the cells that are free
+   now. Food is placed by position in this set, so a state loaded from a file only plays on
+   like the game it was saved from if the order is restored too. Returns false, and leaves
+   the set in level order, if order isn't the free cells. */
+bool snakeRestoreFreeCells(SnakeGameInfo& state, const std::vector<int>& order)
+{
+  int cellCount = state.levelWidth * state.levelHeight;
+  if(order.size() != state.freeCells.size()) return false;
+  for(int slot = 0; slot < (int)order.size(); ++slot){
+    int index = order[slot];
+    /* Marks the cell as taken, so a cell listed twice fails too */
+    if(index < 0 || index >= cellCount || state.occupancy[index].freeSlot < 0){
+      snakeInitOccupancy(state);
+      return false;
+    }
+    state.occupancy[index].freeSlot = -1;
+  }
+  for(int slot = 0; slot < (int)order.size(); ++slot)
+    state.occupancy[order[slot]].freeSlot = slot;
+  state.freeCells = order;
+  return true;
+}
+
+/* Points outside the level (like the [-1, -1] placeholder used during init) are ignored.
+   With an undo record, the change is logged for snakeUndoCell. */
+void snakeOccupyCell(SnakeGameInfo& state, const Point& p, int player, SnakeUndo* undo)
+{
+  if(p.x < 0 || p.y < 0 || p.x >= state.levelWidth || p.y >= state.levelHeight) return;
+  int index = p.x + p.y * state.levelWidth;
+  SnakeCell& cell = state.occupancy[index];
+  SnakeUndoCell change = { index, cell.owner, -1, true };
+  if(cell.count++ == 0 && cell.freeSlot >= 0){
+    change.freeSlot = cell.freeSlot;
+    removeFreeCell(state, index);
+  }
+  cell.owner = player;
+  if(undo) undo->cells.push_back(change);
+}
+
+void snakeVacateCell(SnakeGameInfo& state, const Point& p, SnakeUndo* undo)
+{
+  if(p.x < 0 || p.y < 0 || p.x >= state.levelWidth || p.y >= state.levelHeight) return;
+  int index = p.x + p.y * state.levelWidth;
+  SnakeCell& cell = state.occupancy[index];
+  SnakeUndoCell change = { index, cell.owner, -1, false };
+  if(--cell.count == 0){
+    cell.owner = -1;
+    /* Snakes can crash into walls, and a wall never becomes free */
+    if(!snakeIsCellBorder(p.x, p.y, state.level)){
+      change.freeSlot = state.freeCells.size();
+      addFreeCell(state, index);
+    }
+  }
+  if(undo) undo->cells.push_back(change);
+}
+
+/* Revert one logged occupy or vacate. Changes have to be undone newest first,
+   then the free cell set ends up in exactly the order it was in before. */
+void snakeUndoCell(SnakeGameInfo& state, const SnakeUndoCell& change)
+{
+  SnakeCell& cell = state.occupancy[change.index];
+  if(change.occupied){
+    --cell.count;
+    if(change.freeSlot >= 0){
+      /* Inverse of removeFreeCell: move the cell that was swapped in back to the end */
+      int last = state.freeCells.size();
+      state.freeCells.push_back(change.index);
+      if(change.freeSlot != last){
+	int moved = state.freeCells[change.freeSlot];
+	state.freeCells[last] = moved;
+	state.occupancy[moved].freeSlot = last;
+	state.freeCells[change.freeSlot] = change.index;
+      }
+      cell.freeSlot = change.freeSlot;
+    }
+  } else {
+    ++cell.count;
+    if(change.freeSlot >= 0){
+      state.freeCells.pop_back();
+      cell.freeSlot = -1;
+    }
+  }
+  cell.owner = change.owner;
+}
+
+/* Pick a uniformly random clear cell. Returns false when the level is full. */
+bool snakeRandomFreeCell(SnakeGameInfo& state, Point& p)
+{
+  if(state.freeCells.empty()) return false;
+  int index = state.freeCells[randRange(state.rng, 0, state.freeCells.size() - 1)];
+  p.x = index % state.levelWidth;
+  p.y = index / state.levelWidth;
+  return true;
+}
+
+/* Take a snake that just died off the grid. Dead snakes keep their body parts,
+   but they are no longer obstacles. */
+void snakeRemoveSnake(SnakeGameInfo& state, int player, SnakeUndo* undo)
+{
+  const SnakeInfo& snake = state.snakes[player];
+  for(int eachBodyPart = 0; eachBodyPart < (int)snake.bodyParts.size(); ++eachBodyPart){
+    snakeVacateCell(state, snake.bodyParts[eachBodyPart], undo);
+    state.hash ^= snakeZobristPointKey(state, SnakeZobristBody, player, snake.bodyParts[eachBodyPart]);
+  }
+  state.hash ^= snakeZobristPointKey(state, SnakeZobristHead, player, snake.bodyParts.head());
+  state.hash ^= snakeZobristKey(SnakeZobristGrow, player, snake.growCount);
+  state.hash ^= snakeZobristKey(SnakeZobristDead, player, 0);
+}
+
+/* The key of every feature is a hash of the feature, player and value, rather than a
+   table entry, so it works for any level size and the keys are the same in every process */
+uint64_t snakeZobristKey(SnakeZobristFeature feature, int player, int value)
+{
+  uint64_t z = ((uint64_t)feature << 56) ^ ((uint64_t)(player & 0xff) << 48) ^ (uint32_t)value;
+  /* splitmix64 finalizer */
+  z += 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Points outside the level have no key, just like they have no cell in the occupancy grid */
+uint64_t snakeZobristPointKey(const SnakeGameInfo& state, SnakeZobristFeature feature, int player, const Point& p)
+{
+  if(p.x < 0 || p.y < 0 || p.x >= state.levelWidth || p.y >= state.levelHeight) return 0;
+  return snakeZobristKey(feature, player, p.x + p.y * state.levelWidth);
+}
+
+/* The xor of the keys of every feature of the position. The game updates state.hash
+   as it goes, so this is only needed when a state is built some other way. */
+uint64_t snakeComputeHash(const SnakeGameInfo& state)
+{
+  uint64_t hash = snakeZobristPointKey(state, SnakeZobristFood, 0, state.foodPosition);
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    const SnakeInfo& snake = state.snakes[eachSnake];
+    if(!snake.alive){
+      hash ^= snakeZobristKey(SnakeZobristDead, eachSnake, 0);
+      continue;
+    }
+    for(int eachBodyPart = 0; eachBodyPart < (int)snake.bodyParts.size(); ++eachBodyPart)
+      hash ^= snakeZobristPointKey(state, SnakeZobristBody, eachSnake, snake.bodyParts[eachBodyPart]);
+    if(snake.bodyParts.size() > 0)
+      hash ^= snakeZobristPointKey(state, SnakeZobristHead, eachSnake, snake.bodyParts.head());
+    hash ^= snakeZobristKey(SnakeZobristGrow, eachSnake, snake.growCount);
+  }
+  return hash;
+}
+
+/* Grow the ring to the next power of two >= minCapacity, unwrapping the body so it
+   starts at index 0 again. Does nothing if the capacity is already large enough. */
+void SnakeBody::reserve(int minCapacity)
+{
+  if(minCapacity <= capacity()) return;
+  int newCapacity = 1;
+  while(newCapacity < minCapacity) newCapacity <<= 1;
+
+  std::vector<Point> newParts(newCapacity);
+  for(int i = 0; i < length; ++i)
+    newParts[i] = (*this)[i];
+  parts.swap(newParts);
+  first = 0;
+  mask = newCapacity - 1;
+}
@@ -0,0 +1,46 @@
+#ifndef SNAKEPLUGIN_HPP_GUARD
+#define SNAKEPLUGIN_HPP_GUARD
+#include <stdint.h>
+#include "SnakeGame.hpp"
+
+/*
+  In-process AI plugins (SnakeProtocolPlugin).
+
+  An AI built as a shared object exports SNAKE_PLUGIN_ENTRY, a C function returning
+  its SnakePluginApi table. The controllers load every AI path ending in ".so" with dlopen
+  instead of spawning it, and call move on their own state every tick. There is no
+  process, no pipe and no serialization involved.
+
+  The state is only passed by pointer, so the table carries the ABI version and
+  sizeof(SnakeGameInfo) the plugin was built with, and a plugin that doesn't match is refused.
+  Plugins run inside the controller: only load trusted code. A running move can't be
+  interrupted, so the per-move deadline doesn't apply to plugins.
+
+  SnakePluginExport.cpp implements the table on top of AIMove, so an AI only has to be
+  linked into a shared library together with it.
+*/
+
+#define SNAKE_PLUGIN_ABI_VERSION 1
+#define SNAKE_PLUGIN_ENTRY "snakePluginGetApi"
+
+extern "C" {
+
+struct SnakePluginApi
+{
+  int abiVersion; /* SNAKE_PLUGIN_ABI_VERSION */
+  int stateSize;  /* sizeof(SnakeGameInfo) */
+  /* Called once before the first move. Returns the context passed to move and shutdown, NULL on failure. */
+  void* (*init)(int player, uint64_t seed);
+  /* Returns the Direction to move in. The state must not be changed. */
+  int (*move)(void* context, const SnakeGameInfo* state);
+  void (*shutdown)(void* context);
+};
+
+typedef const SnakePluginApi* (*SnakePluginGetApi)(void);
+
+/* SnakePluginExport.cpp */
+const SnakePluginApi* snakePluginGetApi(void);
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include "SnakePlugin.hpp"
+
+/* Plugin glue around AIMove, see SnakePlugin.hpp. Linked into the AI shared libraries. */
+
+struct PluginContext
+{
+  int player;
+  SnakeAIContext ai;
+};
+
+static void* pluginInit(int player, uint64_t seed)
+{
+  PluginContext* context = new PluginContext;
+  context->player = player;
+  snakeSeedRandom(context->ai.rng, seed);
+  context->ai.data = NULL;
+  context->ai.release = NULL;
+  return context;
+}
+
+static int pluginMove(void* context, const SnakeGameInfo* state)
+{
+  PluginContext* ctx = (PluginContext*)context;
+  /* Exceptions must not cross the C boundary. An AI that throws just loses. */
+  try {
+    Direction d = AIMove(ctx->player, *state, ctx->ai);
+    /* An AI without a move goes right, like in SnakeAIMain.cpp */
+    return d == IllegalDirection ? Right : d;
+  } catch(...){
+    return IllegalDirection;
+  }
+}
+
+static void pluginShutdown(void* context)
+{
+  PluginContext* ctx = (PluginContext*)context;
+  if(ctx->ai.release) ctx->ai.release(ctx->ai.data);
+  delete ctx;
+}
+
+static const SnakePluginApi api = {
+  SNAKE_PLUGIN_ABI_VERSION,
+  sizeof(SnakeGameInfo),
+  pluginInit,
+  pluginMove,
+  pluginShutdown
+};
+
+extern "C" const SnakePluginApi* snakePluginGetApi(void)
+{
+  return &api;
+}
@@ -1,4 +1,8 @@
-#include <boost/lexical_cast.hpp>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include "SnakeGame.hpp"
 
@@ -29,66 +33,594 @@ Specification:
 [snake body[N].y N]
 */
 
+/* Appends v and a newline. Cheaper than going through a stream for every number. */
+static void appendLine(std::string& strm, int v)
+{
+  char buf[16];
+  char* p = buf + sizeof(buf);
+  unsigned int u = v < 0 ? -(unsigned int)v : v;
+  *--p = '\n';
+  do {
+    *--p = (char)('0' + u % 10);
+    u /= 10;
+  } while(u);
+  if(v < 0) *--p = '-';
+  strm.append(p, buf + sizeof(buf) - p);
+}
+
+/* Appends everything after the currentPlayer line */
+static void appendSharedState(const SnakeGameInfo& state, std::string& strm)
+{
+  appendLine(strm, state.levelWidth);
+  appendLine(strm, state.levelHeight);
+  appendLine(strm, state.playerCount);
+  appendLine(strm, state.foodPosition.x);
+  appendLine(strm, state.foodPosition.y);
+  for(int y=0; y<state.levelHeight; ++y){
+    strm += state.level[y];
+    strm += '\n';
+  }
+  for(int i=0; i<state.playerCount; ++i){
+    const SnakeBody& body = state.snakes[i].bodyParts;
+    appendLine(strm, state.snakes[i].alive);
+    appendLine(strm, state.snakes[i].growCount);
+    appendLine(strm, body.size());
+    for(int j=0; j<(int)body.size(); ++j){
+      appendLine(strm, body[j].x);
+      appendLine(strm, body[j].y);
+    }
+  }
+}
+
+/* The text state without its first line (currentPlayer), which is the only part that
+   differs between the players. The controller encodes this once per tick and sends
+   every AI its own currentPlayer line in front of it. */
+void snakeSerializeSharedStateToStream(const SnakeGameInfo& state, std::string& strm)
+{
+  strm.clear();
+  appendSharedState(state, strm);
+}
+
+/* Both encoders write straight into strm, whose capacity is reused from call to call */
 void snakeSerializeStateToStream(const SnakeGameInfo& state, std::string& strm)
 {
-  using boost::lexical_cast;
-  using boost::bad_lexical_cast;
-  using std::string;
+  strm.clear();
+  appendLine(strm, state.currentPlayer);
+  appendSharedState(state, strm);
+}
 
-  std::string out;
+/* Reads one line holding a decimal number, the way std::from_chars would, and steps
+   past its newline. Never reads at or beyond end. */
+static SnakeParseStatus parseLine(const char*& p, const char* end, int& v)
+{
+  const char* q = p;
+  bool negative = false;
+  unsigned int u = 0;
+  if(q != end && *q == '-'){
+    negative = true;
+    ++q;
+  }
+  if(q == end) return SnakeParseTruncated;
+  if(*q < '0' || *q > '9') return SnakeParseMalformed;
+  while(q != end && *q >= '0' && *q <= '9'){
+    unsigned int digit = *q++ - '0';
+    if(u > (INT_MAX - digit) / 10) return SnakeParseOutOfRange;
+    u = u * 10 + digit;
+  }
+  if(q == end) return SnakeParseTruncated;
+  if(*q != '\n') return SnakeParseMalformed;
+  p = q + 1;
+  v = negative ? -(int)u : (int)u;
+  return SnakeParseOk;
+}
 
-  strm = lexical_cast<string>(state.currentPlayer) + '\n';
-  strm += lexical_cast<string>(state.levelWidth) + '\n';
-  strm += lexical_cast<string>(state.levelHeight) + '\n';
-  strm += lexical_cast<string>(state.playerCount) + '\n';
-  strm += lexical_cast<string>(state.foodPosition.x) + '\n';
-  strm += lexical_cast<string>(state.foodPosition.y) + '\n';
-  for(int y=0; y<state.levelHeight; ++y)
-    strm += state.level[y] + '\n';
-  for(int i=0; i<state.playerCount; ++i){
-    strm += lexical_cast<string>(state.snakes[i].alive) + '\n';
-    strm += lexical_cast<string>(state.snakes[i].growCount) + '\n';
-    strm += lexical_cast<string>(state.snakes[i].bodyParts.size()) + '\n';
-    for(int j=0; j<(int)state.snakes[i].bodyParts.size(); ++j){
-      strm += lexical_cast<string>(state.snakes[i].bodyParts[j].x) + '\n';
-      strm += lexical_cast<string>(state.snakes[i].bodyParts[j].y) + '\n';
+/* Like parseLine, for a number that has to be in [min, max] */
+static SnakeParseStatus parseLineInRange(const char*& p, const char* end, int& v, int min, int max)
+{
+  SnakeParseStatus status = parseLine(p, end, v);
+  if(status == SnakeParseOk && (v < min || v > max)) status = SnakeParseOutOfRange;
+  return status;
+}
+
+#define PARSE(expr) do { SnakeParseStatus status_ = (expr); if(status_ != SnakeParseOk) return status_; } while(0)
+
+/* Parses a text state (everything before the END line) from a contiguous buffer in one
+   pass, updating the state in place. Every count is checked against what the input can
+   hold before anything is sized by it, and indices the AIs rely on (currentPlayer) are
+   checked against the state, so bad input is rejected instead of read past.
+   The level rows and snake bodies keep their buffers, so once the state has been
+   through one message of this size, parsing doesn't allocate. */
+SnakeParseStatus snakeParseTextState(SnakeGameInfo& state, const char* text, size_t length)
+{
+  const char* p = text;
+  const char* end = text + length;
+  int snakeLength, alive;
+
+  PARSE(parseLine(p, end, state.currentPlayer));
+  PARSE(parseLineInRange(p, end, state.levelWidth, 1, INT_MAX));
+  PARSE(parseLineInRange(p, end, state.levelHeight, 1, INT_MAX));
+  PARSE(parseLineInRange(p, end, state.playerCount, 1, INT_MAX));
+  if(state.currentPlayer < 0 || state.currentPlayer >= state.playerCount) return SnakeParseOutOfRange;
+  PARSE(parseLine(p, end, state.foodPosition.x));
+  PARSE(parseLine(p, end, state.foodPosition.y));
+
+  /* The rows take a byte per cell (the last one at least one less) plus the newlines, so a
+     level with more cells than the input has bytes can't be there. Checked before anything
+     is allocated for it. */
+  size_t cellCount = (size_t)state.levelWidth * (size_t)state.levelHeight;
+  if(cellCount > (size_t)(end - p) || cellCount > INT_MAX) return SnakeParseTruncated;
+  if((size_t)(end - p) / ((size_t)state.levelWidth + 1) < (size_t)state.levelHeight - 1) return SnakeParseTruncated;
+  state.level.resize(state.levelHeight);
+  for(int y = 0; y < state.levelHeight; ++y){
+    const char* eol = (const char*)memchr(p, '\n', end - p);
+    if(!eol) return SnakeParseTruncated;
+    /* The game indexes the rows without checking, so every row is as wide as the level. Only
+       the last one may be shorter, when the level file doesn't end in a newline; it is padded
+       with floor, which is how the controller sees the cells past its end. */
+    int rowLength = eol - p;
+    if(rowLength > state.levelWidth || (rowLength < state.levelWidth && y < state.levelHeight - 1))
+      return SnakeParseMalformed;
+    state.level[y].assign(p, eol);
+    state.level[y].resize(state.levelWidth, ' ');
+    p = eol + 1;
+  }
+
+  /* A snake takes at least three lines of two bytes */
+  if((size_t)(end - p) / 6 < (size_t)state.playerCount) return SnakeParseTruncated;
+  state.snakes.resize(state.playerCount);
+  for(int i = 0; i < state.playerCount; ++i){
+    SnakeInfo& snake = state.snakes[i];
+    PARSE(parseLineInRange(p, end, alive, 0, 1));
+    snake.alive = alive != 0;
+    PARSE(parseLineInRange(p, end, snake.growCount, 0, INT_MAX));
+    PARSE(parseLineInRange(p, end, snakeLength, 0, (int)cellCount));
+    /* Two lines of two bytes per body part; only reserve what the input can hold, the ring
+       buffer grows by itself later */
+    if((size_t)(end - p) / 4 < (size_t)snakeLength) return SnakeParseTruncated;
+    snake.bodyParts.clear();
+    snake.bodyParts.reserve(snakeLength);
+    for(int j = 0; j < snakeLength; ++j){
+      Point bodyPart;
+      PARSE(parseLine(p, end, bodyPart.x));
+      PARSE(parseLine(p, end, bodyPart.y));
+      snake.bodyParts.pushTail(bodyPart);
     }
   }
+  if(p != end) return SnakeParseMalformed;
+
+  snakeInitOccupancy(state);
+  state.hash = snakeComputeHash(state);
+  return SnakeParseOk;
 }
 
+#undef PARSE
+
+/* For callers that have the state as lines already */
 bool snakeSerializeStreamToState(SnakeGameInfo& state, const std::vector<std::string>& strm)
 {
-  using boost::lexical_cast;
-  using boost::bad_lexical_cast;
-  int snakeLength, pos = 0;
-  bool ret = true;
-  try {
-    state.currentPlayer = lexical_cast<int>(strm[pos++]);
-    state.levelWidth = lexical_cast<int>(strm[pos++]);
-    state.levelHeight = lexical_cast<int>(strm[pos++]);
-    state.playerCount = lexical_cast<int>(strm[pos++]);
-    state.foodPosition.x = lexical_cast<int>(strm[pos++]);
-    state.foodPosition.y = lexical_cast<int>(strm[pos++]);
-    for(int y=0; y<state.levelHeight; ++y)
-      state.level.push_back(strm[pos++]);
-    state.snakes.resize(state.playerCount);
-    for(int i=0; i<state.playerCount; ++i){
-      SnakeInfo snake;
-      snake.alive = lexical_cast<bool>(strm[pos++]);
-      snake.growCount = lexical_cast<int>(strm[pos++]);
-      snakeLength = lexical_cast<int>(strm[pos++]);
-      snake.bodyParts.resize(snakeLength);
-      for(int j = 0; j < snakeLength; ++j){
-	Point p;
-	p.x = lexical_cast<int>(strm[pos++]);
-	p.y = lexical_cast<int>(strm[pos++]);
-	snake.bodyParts[j] = p;
-      }
-      state.snakes[i] = snake;
+  std::string text;
+  for(int i = 0; i < (int)strm.size(); ++i){
+    text += strm[i];
+    text += '\n';
+  }
+  return snakeParseTextState(state, text.data(), text.size()) == SnakeParseOk;
+}
+
+const char* snakeProtocolName(SnakeProtocol protocol)
+{
+  switch(protocol){
+  case SnakeProtocolBinary: return "binary";
+  case SnakeProtocolDelta: return "delta";
+  case SnakeProtocolSharedMemory: return "shm";
+  case SnakeProtocolPlugin: return "plugin";
+  default: return "text";
+  }
+}
+
+bool snakeParseProtocolName(const std::string& name, SnakeProtocol& protocol)
+{
+  if(name == "text") protocol = SnakeProtocolText;
+  else if(name == "binary") protocol = SnakeProtocolBinary;
+  else if(name == "delta") protocol = SnakeProtocolDelta;
+  else if(name == "shm") protocol = SnakeProtocolSharedMemory;
+  else return false;
+  return true;
+}
+
+/*
+Binary specification (opt-in, see SnakeProtocol). All fields are little endian.
+
+Header, SNAKE_BINARY_HEADER_SIZE bytes:
+[magic "SNKB", 4 bytes]
+[version, u8]
+[message type, u8]
+[currentPlayer, u16]
+[payload length in bytes, u32]
+
+Full state payload:
+[mapwidth, u16]
+[mapheight, u16]
+[playerCount, u16]
+[foodPosition.x, i16]
+[foodPosition.y, i16]
+[wall grid, (mapwidth * mapheight + 7) / 8 bytes, one bit per cell, lowest bit first]
+[snake alive 1, u8]
+[snake growcount 1, u32]
+[snake length 1, u32]
+[snake body[0].x 1, i16]
+[snake body[0].y 1, i16]
+[snake body steps 1, (2 * (length - 1) + 7) / 8 bytes]
+...
+[snake alive N]
+...
+
+Body parts are always next to each other, so after the head each part is stored as
+the 2-bit Direction leading from the previous part to it.
+
+Delta payload (SnakeProtocolDelta, only valid on top of the previous state):
+[playerCount, u16]
+[foodPosition.x, i16]
+[foodPosition.y, i16]
+[snake alive 1, u8]
+[snake growcount 1, u32]
+[snake length 1, u32]
+[snake body[0].x 1, i16]
+[snake body[0].y 1, i16]
+...
+[snake alive N]
+...
+
+A snake moves at most one cell per tick, so the receiver can tell from the length
+and the head alone whether the snake moved, grew or stood still (dead snakes).
+*/
+
+static void putU8(std::string& strm, int v)
+{
+  strm += (char)(v & 0xff);
+}
+
+static void putU16(std::string& strm, int v)
+{
+  strm += (char)(v & 0xff);
+  strm += (char)((v >> 8) & 0xff);
+}
+
+static void putU32(std::string& strm, unsigned int v)
+{
+  strm += (char)(v & 0xff);
+  strm += (char)((v >> 8) & 0xff);
+  strm += (char)((v >> 16) & 0xff);
+  strm += (char)((v >> 24) & 0xff);
+}
+
+static int getU16(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static int getI16(const unsigned char* p)
+{
+  return (short)getU16(p);
+}
+
+static unsigned int getU32(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static Direction stepDirection(const Point& from, const Point& to)
+{
+  if(to.y < from.y) return Up;
+  if(to.y > from.y) return Down;
+  if(to.x < from.x) return Left;
+  return Right;
+}
+
+static int beginBinaryMessage(std::string& strm, SnakeMessageType type, int currentPlayer)
+{
+  strm.clear();
+  strm.append(SNAKE_BINARY_MAGIC, 4);
+  putU8(strm, SNAKE_BINARY_VERSION);
+  putU8(strm, type);
+  putU16(strm, currentPlayer);
+  putU32(strm, 0); /* Payload length, patched by endBinaryMessage */
+  return strm.size();
+}
+
+static void endBinaryMessage(std::string& strm, int payloadStart)
+{
+  int payloadLength = strm.size() - payloadStart;
+  for(int b = 0; b < 4; ++b)
+    strm[payloadStart - 4 + b] = (char)((payloadLength >> (8 * b)) & 0xff);
+}
+
+void snakeSerializeStateToBinary(const SnakeGameInfo& state, std::string& strm)
+{
+  int cellCount = state.levelWidth * state.levelHeight;
+  int payloadStart = beginBinaryMessage(strm, SnakeMessageFullState, state.currentPlayer);
+
+  putU16(strm, state.levelWidth);
+  putU16(strm, state.levelHeight);
+  putU16(strm, state.playerCount);
+  putU16(strm, state.foodPosition.x);
+  putU16(strm, state.foodPosition.y);
+
+  strm.append((cellCount + 7) / 8, '\0');
+  char* walls = &strm[strm.size() - (cellCount + 7) / 8];
+  for(int y = 0; y < state.levelHeight; ++y){
+    for(int x = 0; x < state.levelWidth; ++x){
+      int cell = x + y * state.levelWidth;
+      if(snakeIsCellBorder(x, y, state.level))
+	walls[cell >> 3] |= (char)(1 << (cell & 7));
     }
-  } catch(bad_lexical_cast& ex){
-    ret = false;
   }
 
+  for(int i = 0; i < state.playerCount; ++i){
+    const SnakeBody& body = state.snakes[i].bodyParts;
+    putU8(strm, state.snakes[i].alive);
+    putU32(strm, state.snakes[i].growCount);
+    putU32(strm, body.size());
+    if(body.size() == 0) continue;
+    putU16(strm, body[0].x);
+    putU16(strm, body[0].y);
+    int steps = body.size() - 1;
+    strm.append((2 * steps + 7) / 8, '\0');
+    char* packed = &strm[strm.size() - (2 * steps + 7) / 8];
+    for(int j = 0; j < steps; ++j){
+      int bit = 2 * j;
+      packed[bit >> 3] |= (char)(stepDirection(body[j], body[j + 1]) << (bit & 7));
+    }
+  }
+  endBinaryMessage(strm, payloadStart);
+}
+
+void snakeSerializeDeltaToBinary(const SnakeGameInfo& state, std::string& strm)
+{
+  int payloadStart = beginBinaryMessage(strm, SnakeMessageDelta, state.currentPlayer);
+
+  putU16(strm, state.playerCount);
+  putU16(strm, state.foodPosition.x);
+  putU16(strm, state.foodPosition.y);
+  for(int i = 0; i < state.playerCount; ++i){
+    const SnakeBody& body = state.snakes[i].bodyParts;
+    putU8(strm, state.snakes[i].alive);
+    putU32(strm, state.snakes[i].growCount);
+    putU32(strm, body.size());
+    putU16(strm, body[0].x);
+    putU16(strm, body[0].y);
+  }
+  endBinaryMessage(strm, payloadStart);
+}
+
+/* Changes the currentPlayer of an encoded binary message (or of a copy of its header),
+   so one encoding can be sent to every player */
+void snakeBinarySetPlayer(char* header, int currentPlayer)
+{
+  header[6] = (char)(currentPlayer & 0xff);
+  header[7] = (char)((currentPlayer >> 8) & 0xff);
+}
+
+/* Returns the size of the whole message (header included) described by a binary header,
+   or -1 if the header is not valid. */
+int snakeBinaryMessageLength(const char* header)
+{
+  const unsigned char* p = (const unsigned char*)header;
+  if(memcmp(header, SNAKE_BINARY_MAGIC, 4) != 0) return -1;
+  if(p[4] != SNAKE_BINARY_VERSION) return -1;
+  unsigned int payloadLength = getU32(p + 8);
+  if(payloadLength > SNAKE_BINARY_MAX_PAYLOAD) return -1;
+  return SNAKE_BINARY_HEADER_SIZE + payloadLength;
+}
+
+/* Upper bound for a full state message on this level, with every snake as long as the level is large */
+int snakeBinaryMaxMessageLength(const SnakeGameInfo& state)
+{
+  int cellCount = state.levelWidth * state.levelHeight;
+  int snakeSize = 9 + 4 + (2 * (cellCount - 1) + 7) / 8;
+  return SNAKE_BINARY_HEADER_SIZE + 10 + (cellCount + 7) / 8 + state.playerCount * snakeSize;
+}
+
+static bool decodeFullState(SnakeGameInfo& state, const unsigned char* p, const unsigned char* end)
+{
+  if(end - p < 10) return false;
+  state.levelWidth = getU16(p);
+  state.levelHeight = getU16(p + 2);
+  state.playerCount = getU16(p + 4);
+  state.foodPosition.x = getI16(p + 6);
+  state.foodPosition.y = getI16(p + 8);
+  p += 10;
+
+  int cellCount = state.levelWidth * state.levelHeight;
+  if(end - p < (cellCount + 7) / 8) return false;
+  state.level.resize(state.levelHeight);
+  for(int y = 0; y < state.levelHeight; ++y){
+    state.level[y].resize(state.levelWidth);
+    for(int x = 0; x < state.levelWidth; ++x){
+      int cell = x + y * state.levelWidth;
+      state.level[y][x] = (p[cell >> 3] & (1 << (cell & 7))) ? 'x' : ' ';
+    }
+  }
+  p += (cellCount + 7) / 8;
+
+  state.snakes.resize(state.playerCount);
+  for(int i = 0; i < state.playerCount; ++i){
+    SnakeInfo& snake = state.snakes[i];
+    if(end - p < 9) return false;
+    snake.alive = p[0] != 0;
+    snake.growCount = getU32(p + 1);
+    unsigned int snakeLength = getU32(p + 5);
+    p += 9;
+    snake.bodyParts.clear();
+    if(snakeLength == 0) continue;
+    if(snakeLength > (unsigned int)cellCount || end - p < 4) return false;
+    snake.bodyParts.reserve(cellCount);
+    Point part(getI16(p), getI16(p + 2));
+    p += 4;
+    snake.bodyParts.pushTail(part);
+    int steps = snakeLength - 1;
+    if(end - p < (2 * steps + 7) / 8) return false;
+    for(int j = 0; j < steps; ++j){
+      int bit = 2 * j;
+      part = snakeComputeNewHead(part, (Direction)((p[bit >> 3] >> (bit & 7)) & 3));
+      snake.bodyParts.pushTail(part);
+    }
+    p += (2 * steps + 7) / 8;
+  }
+  if(p != end) return false;
+  snakeInitOccupancy(state);
+  state.hash = snakeComputeHash(state);
+  return true;
+}
+
+/* Applies a delta to the previous state, keeping the occupancy grid up to date
+   the same way snakeGameTick does. */
+static bool decodeDelta(SnakeGameInfo& state, const unsigned char* p, const unsigned char* end)
+{
+  if(end - p < 6) return false;
+  if(getU16(p) != state.playerCount || (int)state.snakes.size() != state.playerCount) return false;
+  /* The hash follows every change as it is applied, like snakeMakeTick does */
+  state.hash ^= snakeZobristPointKey(state, SnakeZobristFood, 0, state.foodPosition);
+  state.foodPosition.x = getI16(p + 2);
+  state.foodPosition.y = getI16(p + 4);
+  state.hash ^= snakeZobristPointKey(state, SnakeZobristFood, 0, state.foodPosition);
+  p += 6;
+
+  if(end - p != 13 * state.playerCount) return false;
+  for(int i = 0; i < state.playerCount; ++i, p += 13){
+    SnakeInfo& snake = state.snakes[i];
+    bool wasAlive = snake.alive;
+    int snakeLength = (int)getU32(p + 5);
+    Point head(getI16(p + 9), getI16(p + 11));
+    if(snake.bodyParts.size() == 0) return false;
+    Point oldHead = snake.bodyParts.head();
+
+    if(snakeLength == snake.bodyParts.size() + 1 || !(head == oldHead)){
+      /* The snake moved one step */
+      if(std::abs(head.x - oldHead.x) + std::abs(head.y - oldHead.y) != 1) return false;
+      if(snakeLength == snake.bodyParts.size() + 1){
+	snake.bodyParts.pushHead(head);
+      } else if(snakeLength == snake.bodyParts.size()){
+	if(wasAlive){
+	  snakeVacateCell(state, snake.bodyParts.tail());
+	  state.hash ^= snakeZobristPointKey(state, SnakeZobristBody, i, snake.bodyParts.tail());
+	}
+	snake.bodyParts.advance(head);
+      } else return false;
+      /* A dead snake is only its SnakeZobristDead key, whatever its body does */
+      if(wasAlive){
+	snakeOccupyCell(state, head, i);
+	state.hash ^= snakeZobristPointKey(state, SnakeZobristHead, i, oldHead);
+	state.hash ^= snakeZobristPointKey(state, SnakeZobristHead, i, head);
+	state.hash ^= snakeZobristPointKey(state, SnakeZobristBody, i, head);
+      }
+    } else if(snakeLength != snake.bodyParts.size()) return false;
+
+    /* Dead snakes are off the grid for good, one coming back would need a full state */
+    if(!wasAlive && p[0] != 0) return false;
+    if(wasAlive) state.hash ^= snakeZobristKey(SnakeZobristGrow, i, snake.growCount);
+    snake.growCount = getU32(p + 1);
+    if(wasAlive) state.hash ^= snakeZobristKey(SnakeZobristGrow, i, snake.growCount);
+    snake.alive = p[0] != 0;
+    if(wasAlive && !snake.alive)
+      snakeRemoveSnake(state, i);
+  }
+  return true;
+}
+
+/* Decodes a binary message. Full states replace the whole state,
+   deltas are applied on top of the state from the previous message. */
+bool snakeSerializeBinaryToState(SnakeGameInfo& state, const char* strm, int length)
+{
+  const unsigned char* p = (const unsigned char*)strm;
+
+  if(length < SNAKE_BINARY_HEADER_SIZE || snakeBinaryMessageLength(strm) != length) return false;
+  state.currentPlayer = getU16(p + 6);
+  bool ok = false;
+  switch(p[5]){
+  case SnakeMessageFullState:
+    ok = decodeFullState(state, p + SNAKE_BINARY_HEADER_SIZE, p + length);
+    break;
+  case SnakeMessageDelta:
+    ok = decodeDelta(state, p + SNAKE_BINARY_HEADER_SIZE, p + length);
+    break;
+  }
+  /* The AIs index the snakes with it, a delta keeps the player count it was sent against */
+  return ok && state.currentPlayer < state.playerCount;
+}
+
+SnakeStateReader::SnakeStateReader(int _fd) : fd(_fd), buffer(4096), begin(0), end(0)
+{
+}
+
+/* Moves the unread bytes to the front of the buffer and reads more from the fd,
+   growing the buffer if it is full. Returns false on end of file or error. */
+static bool readMore(SnakeStateReader& reader)
+{
+  if(reader.begin > 0){
+    memmove(&reader.buffer[0], &reader.buffer[reader.begin], reader.end - reader.begin);
+    reader.end -= reader.begin;
+    reader.begin = 0;
+  }
+  if(reader.end == reader.buffer.size())
+    reader.buffer.resize(reader.buffer.size() * 2);
+  for(;;){
+    ssize_t n = read(reader.fd, &reader.buffer[reader.end], reader.buffer.size() - reader.end);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return false;
+    reader.end += n;
+    return true;
+  }
+}
+
+/* Makes sure at least count unread bytes are buffered */
+static bool readAtLeast(SnakeStateReader& reader, size_t count)
+{
+  if(reader.buffer.size() < count)
+    reader.buffer.resize(count);
+  while(reader.end - reader.begin < count){
+    if(!readMore(reader)) return false;
+  }
+  return true;
+}
+
+static bool readBinaryState(SnakeStateReader& reader, SnakeGameInfo& state)
+{
+  if(!readAtLeast(reader, SNAKE_BINARY_HEADER_SIZE)) return false;
+  int length = snakeBinaryMessageLength(&reader.buffer[reader.begin]);
+  if(length < 0 || !readAtLeast(reader, length)) return false;
+  bool ret = snakeSerializeBinaryToState(state, &reader.buffer[reader.begin], length);
+  reader.begin += length;
   return ret;
 }
+
+/* Finds the END line and parses the state in front of it right where it is in the buffer */
+static bool readTextState(SnakeStateReader& reader, SnakeGameInfo& state)
+{
+  /* Start of the line being looked at, from reader.begin, which readMore may move */
+  size_t lineStart = 0;
+  for(;;){
+    const char* first = &reader.buffer[reader.begin];
+    const char* eol = (const char*)memchr(first + lineStart, '\n', reader.end - reader.begin - lineStart);
+    if(!eol){
+      if(!readMore(reader)) return false;
+      continue;
+    }
+    size_t lineEnd = eol - first;
+    if(lineEnd - lineStart == 3 && memcmp(first + lineStart, "END", 3) == 0){
+      SnakeParseStatus status = snakeParseTextState(state, first, lineStart);
+      reader.begin += lineEnd + 1;
+      return status == SnakeParseOk;
+    }
+    lineStart = lineEnd + 1;
+  }
+}
+
+/* Reads one state message in either format into a long-lived state.
+   Binary messages are recognized by their magic; text states are terminated by an END line. */
+bool snakeReadState(SnakeStateReader& reader, SnakeGameInfo& state)
+{
+  if(!readAtLeast(reader, 1)) return false;
+  if(reader.buffer[reader.begin] == SNAKE_BINARY_MAGIC[0])
+    return readBinaryState(reader, state);
+  return readTextState(reader, state);
+}
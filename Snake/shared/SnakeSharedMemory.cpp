@@ -0,0 +1,78 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include "SnakeSharedMemory.hpp"
+
+/* AI side of the shared memory transport. See SnakeSharedMemory.hpp for the layout. */
+
+bool snakeShmConnect(SnakeShmClient& client)
+{
+  const char* env = getenv(SNAKE_SHM_ENV);
+  void* slot;
+  void* stateArea;
+
+  client.slot = NULL;
+  client.stateArea = NULL;
+  client.tick = 0;
+  if(!env) return false;
+  if(sscanf(env, "%d:%d:%d:%d:%d:%ld", &client.memfd, &client.slotfd, &client.tickfd, &client.movefd,
+	    &client.player, &client.stateSize) != 6)
+    return false;
+
+  slot = mmap(NULL, sizeof(SnakeShmSlot), PROT_READ | PROT_WRITE, MAP_SHARED, client.slotfd, 0);
+  if(slot == MAP_FAILED) return false;
+  stateArea = mmap(NULL, client.stateSize, PROT_READ, MAP_SHARED, client.memfd, 0);
+  if(stateArea == MAP_FAILED){
+    munmap(slot, sizeof(SnakeShmSlot));
+    return false;
+  }
+  client.slot = (SnakeShmSlot*)slot;
+  client.stateArea = (const unsigned char*)stateArea;
+  return true;
+}
+
+void snakeShmDisconnect(SnakeShmClient& client)
+{
+  if(client.slot) munmap(client.slot, sizeof(SnakeShmSlot));
+  if(client.stateArea) munmap((void*)client.stateArea, client.stateSize);
+  client.slot = NULL;
+  client.stateArea = NULL;
+}
+
+/* Blocks until the controller publishes the next state */
+bool snakeShmReadState(SnakeShmClient& client, SnakeGameInfo& state)
+{
+  uint64_t doorbell;
+  const SnakeShmStateHeader* header = (const SnakeShmStateHeader*)client.stateArea;
+  unsigned int sequence;
+  unsigned int length;
+  bool ok;
+
+  if(read(client.tickfd, &doorbell, sizeof(doorbell)) != sizeof(doorbell)) return false;
+  /* Start over if the controller published another state while we were reading, see
+     SnakeShmStateHeader. A torn state may not even decode, so only trust a failure
+     that happened on a stable one. */
+  do {
+    sequence = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+    if(sequence & 1) continue;
+    client.tick = __atomic_load_n(&header->tick, __ATOMIC_RELAXED);
+    length = __atomic_load_n(&header->length, __ATOMIC_RELAXED);
+    ok = length <= client.stateSize - SNAKE_SHM_STATE_DATA_OFFSET &&
+      snakeSerializeBinaryToState(state, (const char*)client.stateArea + SNAKE_SHM_STATE_DATA_OFFSET, length);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while((sequence & 1) || __atomic_load_n(&header->sequence, __ATOMIC_RELAXED) != sequence);
+  if(!ok) return false;
+  /* The state is published once for everybody, so it doesn't know who is reading it */
+  state.currentPlayer = client.player;
+  return true;
+}
+
+bool snakeShmWriteMove(SnakeShmClient& client, Direction direction)
+{
+  uint64_t doorbell = 1;
+  client.slot->move = snakeDirectionToChar(direction);
+  __atomic_store_n(&client.slot->tick, client.tick, __ATOMIC_RELEASE);
+  return write(client.movefd, &doorbell, sizeof(doorbell)) == sizeof(doorbell);
+}
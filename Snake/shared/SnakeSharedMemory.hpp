@@ -0,0 +1,62 @@
+#ifndef SNAKESHAREDMEMORY_HPP_GUARD
+#define SNAKESHAREDMEMORY_HPP_GUARD
+#include "SnakeGame.hpp"
+
+/*
+  Shared memory transport (SnakeProtocolSharedMemory).
+
+  The controller creates a memfd for the state, and one slot memfd per player.
+  The state pages hold a SnakeShmStateHeader followed by a binary full state
+  (see SnakeSerialization.cpp), published once per tick for all AIs. They are sealed,
+  so an AI can only map them read-only. Each AI is only handed its own slot, a
+  SnakeShmSlot at the start of a page, which it maps read-write.
+
+  Two eventfds per AI are used as doorbells: the controller signals "tick" when a new
+  state has been published, and the AI signals "move" once it has written its slot.
+
+  The controller hands the file descriptors and offsets to every AI in the SNAKE_SHM
+  environment variable. An AI that finds it may answer its first (text) state with a
+  "PROTOCOL shm" line; all following states and moves then go through shared memory.
+*/
+
+#define SNAKE_SHM_ENV "SNAKE_SHM"
+/* The binary state starts this far into the state pages */
+#define SNAKE_SHM_STATE_DATA_OFFSET 64
+
+struct SnakeShmSlot
+{
+  unsigned int tick; /* Tick the move answers */
+  unsigned int move; /* 'u', 'd', 'l' or 'r', like on the pipe */
+};
+
+/* The header and the state are guarded like a seqlock: sequence is odd while the
+   controller writes them, and an AI that sees it change while reading starts over.
+   That happens when an AI that missed its deadline is still reading as the next
+   state gets published. */
+struct SnakeShmStateHeader
+{
+  unsigned int sequence; /* Odd while a state is being written */
+  unsigned int tick;     /* Incremented for every published state */
+  unsigned int length;   /* Length of the binary message */
+};
+
+struct SnakeShmClient
+{
+  int memfd;
+  int slotfd;
+  int tickfd;
+  int movefd;
+  int player;
+  long stateSize;
+  unsigned int tick;
+  SnakeShmSlot* slot;
+  const unsigned char* stateArea;
+};
+
+/* SnakeSharedMemory.cpp */
+bool snakeShmConnect(SnakeShmClient& client);
+void snakeShmDisconnect(SnakeShmClient& client);
+bool snakeShmReadState(SnakeShmClient& client, SnakeGameInfo& state);
+bool snakeShmWriteMove(SnakeShmClient& client, Direction direction);
+
+#endif
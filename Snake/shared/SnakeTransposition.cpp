@@ -0,0 +1,66 @@
+#include "SnakeTransposition.hpp"
+
+/* data layout: score in bits 0-31, depth in 32-39, bound in 40-41, move in 42-44,
+   generation in 48-55. Bit 63 is always set, so an empty slot (all zero) never matches. */
+static uint64_t packEntry(const SnakeTranspositionEntry& entry, unsigned int generation)
+{
+  return (uint64_t)(uint32_t)entry.score |
+    ((uint64_t)(entry.depth & 0xff) << 32) |
+    ((uint64_t)(entry.bound & 3) << 40) |
+    ((uint64_t)(entry.move & 7) << 42) |
+    ((uint64_t)(generation & 0xff) << 48) |
+    ((uint64_t)1 << 63);
+}
+
+static void unpackEntry(uint64_t data, SnakeTranspositionEntry& entry)
+{
+  entry.score = (int32_t)(uint32_t)data;
+  entry.depth = (data >> 32) & 0xff;
+  entry.bound = (SnakeBound)((data >> 40) & 3);
+  entry.move = (data >> 42) & 7;
+}
+
+/* 1 << sizeLog2 slots of 16 bytes, all empty */
+void snakeTranspositionInit(SnakeTranspositionTable& table, int sizeLog2)
+{
+  table.slots.resize((size_t)1 << sizeLog2);
+  table.mask = ((uint64_t)1 << sizeLog2) - 1;
+  snakeTranspositionClear(table);
+}
+
+void snakeTranspositionClear(SnakeTranspositionTable& table)
+{
+  SnakeTranspositionSlot empty = { 0, 0 };
+  table.slots.assign(table.slots.size(), empty);
+  table.generation = 0;
+}
+
+void snakeTranspositionNewSearch(SnakeTranspositionTable& table)
+{
+  table.generation = (table.generation + 1) & 0xff;
+}
+
+bool snakeTranspositionProbe(const SnakeTranspositionTable& table, uint64_t key, SnakeTranspositionEntry& entry)
+{
+  const SnakeTranspositionSlot& slot = table.slots[key & table.mask];
+  uint64_t check = __atomic_load_n(&slot.check, __ATOMIC_RELAXED);
+  uint64_t data = __atomic_load_n(&slot.data, __ATOMIC_RELAXED);
+  if(data == 0 || (check ^ data) != key) return false;
+  unpackEntry(data, entry);
+  return true;
+}
+
+/* Replace by depth: keep the old entry if it is from this search and was searched deeper */
+void snakeTranspositionStore(SnakeTranspositionTable& table, uint64_t key, const SnakeTranspositionEntry& entry)
+{
+  SnakeTranspositionSlot& slot = table.slots[key & table.mask];
+  uint64_t check = __atomic_load_n(&slot.check, __ATOMIC_RELAXED);
+  uint64_t oldData = __atomic_load_n(&slot.data, __ATOMIC_RELAXED);
+  if(oldData != 0 && (check ^ oldData) != key &&
+     ((oldData >> 48) & 0xff) == table.generation &&
+     (int)((oldData >> 32) & 0xff) > entry.depth)
+    return;
+  uint64_t data = packEntry(entry, table.generation);
+  __atomic_store_n(&slot.data, data, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot.check, key ^ data, __ATOMIC_RELAXED);
+}
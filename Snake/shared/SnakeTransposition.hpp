@@ -0,0 +1,55 @@
+#ifndef SNAKETRANSPOSITION_HPP_GUARD
+#define SNAKETRANSPOSITION_HPP_GUARD
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+/*
+  Transposition table for the search AIs, keyed by SnakeGameInfo::hash.
+
+  A fixed number of slots (a power of two), one entry each. A new entry replaces the
+  old one unless the old one is from the current search and was searched deeper.
+  Call snakeTranspositionNewSearch before every move, so the entries from earlier
+  moves age out instead of filling the table with deep but stale results.
+
+  Several search threads can share one table without locks: every slot stores
+  key ^ data next to data, so a slot torn by two threads writing at once doesn't
+  match any key and simply misses.
+*/
+
+enum SnakeBound
+{
+  SnakeBoundExact = 0,
+  SnakeBoundLower = 1, /* The score is at least this (the search failed high) */
+  SnakeBoundUpper = 2  /* The score is at most this (the search failed low) */
+};
+
+struct SnakeTranspositionEntry
+{
+  int score;
+  int depth;
+  SnakeBound bound;
+  int move; /* Best move found, a Direction, or IllegalDirection for none */
+};
+
+struct SnakeTranspositionSlot
+{
+  uint64_t check; /* key ^ data */
+  uint64_t data;
+};
+
+struct SnakeTranspositionTable
+{
+  std::vector<SnakeTranspositionSlot> slots;
+  uint64_t mask;
+  unsigned int generation;
+};
+
+/* SnakeTransposition.cpp */
+void snakeTranspositionInit(SnakeTranspositionTable& table, int sizeLog2);
+void snakeTranspositionClear(SnakeTranspositionTable& table);
+void snakeTranspositionNewSearch(SnakeTranspositionTable& table);
+bool snakeTranspositionProbe(const SnakeTranspositionTable& table, uint64_t key, SnakeTranspositionEntry& entry);
+void snakeTranspositionStore(SnakeTranspositionTable& table, uint64_t key, const SnakeTranspositionEntry& entry);
+
+#endif
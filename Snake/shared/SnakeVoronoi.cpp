@@ -0,0 +1,72 @@
+#include "SnakeVoronoi.hpp"
+
+/* Claims a cell for owner at distance, or marks it contested if somebody else got
+   there in the same number of moves */
+static void visit(SnakeVoronoi& voronoi, int index, int owner, int distance)
+{
+  if(!voronoi.open[index]) return;
+  if(voronoi.distance[index] < 0){
+    voronoi.distance[index] = distance;
+    voronoi.owner[index] = owner;
+    voronoi.next.push_back(index);
+  } else if(voronoi.distance[index] == distance && voronoi.owner[index] != owner)
+    voronoi.owner[index] = SNAKE_VORONOI_CONTESTED;
+}
+
+void snakeVoronoiCompute(const SnakeGameInfo& state, SnakeVoronoi& voronoi)
+{
+  int width = state.levelWidth;
+  int height = state.levelHeight;
+  int cells = (width + 2) * (height + 2);
+  int stride = width + 2;
+
+  voronoi.stride = stride;
+  voronoi.owner.assign(cells, SNAKE_VORONOI_NOBODY);
+  voronoi.distance.assign(cells, -1);
+  voronoi.open.assign(cells, 0);
+  voronoi.territory.assign(state.snakes.size(), 0);
+  voronoi.foodDistance.assign(state.snakes.size(), -1);
+  voronoi.frontier.clear();
+  voronoi.next.clear();
+  for(int y = 0; y < height; ++y){
+    const std::string& row = state.level[y];
+    const SnakeCell* occupancy = &state.occupancy[y * width];
+    char* open = &voronoi.open[snakeVoronoiCell(voronoi, 0, y)];
+    for(int x = 0; x < width; ++x)
+      open[x] = row[x] != 'x' && occupancy[x].count == 0;
+  }
+
+  /* The heads are occupied, so they're the only cells that are searched from without being open */
+  for(int eachSnake = 0; eachSnake < (int)state.snakes.size(); ++eachSnake){
+    if(!state.snakes[eachSnake].alive) continue;
+    Point head = state.snakes[eachSnake].bodyParts[0];
+    if(head.x < 0 || head.y < 0 || head.x >= width || head.y >= height) continue;
+    voronoi.frontier.push_back(snakeVoronoiCell(voronoi, head.x, head.y));
+    voronoi.owner[voronoi.frontier.back()] = eachSnake;
+  }
+
+  for(int distance = 1; !voronoi.frontier.empty(); ++distance){
+    for(int i = 0; i < (int)voronoi.frontier.size(); ++i){
+      int index = voronoi.frontier[i];
+      int owner = voronoi.owner[index];
+      /* Contested cells are a dead end for everybody */
+      if(owner < 0) continue;
+      visit(voronoi, index + 1, owner, distance);
+      visit(voronoi, index - 1, owner, distance);
+      visit(voronoi, index + stride, owner, distance);
+      visit(voronoi, index - stride, owner, distance);
+    }
+    voronoi.frontier.swap(voronoi.next);
+    voronoi.next.clear();
+  }
+
+  for(int index = 0; index < cells; ++index)
+    if(voronoi.owner[index] >= 0 && voronoi.distance[index] > 0)
+      ++voronoi.territory[voronoi.owner[index]];
+  if(state.foodPosition.x >= 0 && state.foodPosition.x < width &&
+     state.foodPosition.y >= 0 && state.foodPosition.y < height){
+    int food = snakeVoronoiCell(voronoi, state.foodPosition.x, state.foodPosition.y);
+    if(voronoi.owner[food] >= 0 && voronoi.distance[food] > 0)
+      voronoi.foodDistance[voronoi.owner[food]] = voronoi.distance[food];
+  }
+}
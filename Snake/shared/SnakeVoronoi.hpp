@@ -0,0 +1,44 @@
+#ifndef SNAKEVORONOI_HPP_GUARD
+#define SNAKEVORONOI_HPP_GUARD
+#include <vector>
+#include "SnakeGame.hpp"
+
+/*
+  Territory evaluation: one breadth first search from the heads of all live snakes at once,
+  so every clear cell ends up with the player that can reach it first.
+  Cells two players reach at the same time are contested, belong to nobody, and
+  the search doesn't continue through them.
+
+  Keep one SnakeVoronoi around and pass it to snakeVoronoiCompute every turn:
+  all buffers are reused, so only the first call allocates.
+*/
+
+#define SNAKE_VORONOI_NOBODY -1    /* Walls, snakes and unreachable cells */
+#define SNAKE_VORONOI_CONTESTED -2
+
+struct SnakeVoronoi
+{
+  /* Per cell. The grid has a one cell margin all around the level, so the search never
+     needs a bounds check; use snakeVoronoiCell to index it. */
+  int stride;
+  std::vector<int> owner;    /* Player id, SNAKE_VORONOI_NOBODY or SNAKE_VORONOI_CONTESTED */
+  std::vector<int> distance; /* Moves it takes the owner to get there, -1 if nobody can */
+  /* Per player */
+  std::vector<int> territory;    /* Cells the player reaches first */
+  std::vector<int> foodDistance; /* Moves to the food if the player gets there first, otherwise -1 */
+  /* Scratch: which cells can be entered, then the search frontiers */
+  std::vector<char> open;
+  std::vector<int> frontier;
+  std::vector<int> next;
+};
+
+/* Index of level cell [x, y] in the per cell vectors */
+inline int snakeVoronoiCell(const SnakeVoronoi& voronoi, int x, int y)
+{
+  return (x + 1) + (y + 1) * voronoi.stride;
+}
+
+/* SnakeVoronoi.cpp */
+void snakeVoronoiCompute(const SnakeGameInfo& state, SnakeVoronoi& voronoi);
+
+#endif
@@ -0,0 +1,87 @@
+#include <signal.h>
+#include <time.h>
+#include <cstdio>
+#include "shared/SnakeGame.hpp"
+#include "SnakeIPC.hpp"
+
+/*
+  Runs a few ticks the way SnakeController.cpp does when it's paced: the AIs get a
+  deadline shorter than the tick period, and the controller is busy past the deadline
+  before it gets to recv_ipc. An AI that answers right away must not be charged a miss
+  for that.
+
+  Usage: SnakeDeadlineTest <level> <AI>...
+*/
+
+static const int TEST_TICKS = 10;
+static const int TEST_DEADLINE_MS = 10;
+/* Stands in for drawing and bookkeeping, longer than the deadline */
+static const int TEST_BUSY_MS = 50;
+
+static void sleep_ms(int ms)
+{
+  struct timespec ts;
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000000L;
+  while(nanosleep(&ts, &ts) != 0);
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 3){
+    printf("Usage: %s <level> <AI>...\n", argv[0]);
+    return 1;
+  }
+  int numPlayers = argc - 2;
+  SnakeGameInfo state;
+  std::vector<Direction> playerInputs(numPlayers);
+  std::vector<childproc_t> procList(numPlayers);
+  std::vector<pipearr_t> strms;
+  shmtransport_t shm;
+  sendbuffers_t sendBuffers;
+  snakeoptions_t options;
+
+  signal(SIGPIPE, SIG_IGN);
+  options.deadlineMs = TEST_DEADLINE_MS;
+  for(int i = 0; i < numPlayers; ++i){
+    procList[i].path = argv[i + 2];
+    procList[i].seed = snakePlayerSeed(0, i);
+    procList[i].deadlineMs = options.deadlineMs;
+  }
+  if(!snakeInitLevel(argv[1], state)){
+    printf("Couldn't open level \"%s\"\n", argv[1]);
+    return 1;
+  }
+  snakeSeedRandom(state.rng, 0);
+  snakeInitSnakes(state, numPlayers);
+  snakeInitFood(state);
+  state.vs = NULL;
+  init_shm(state, shm);
+  if(!init_ipc(procList, strms, numPlayers, shm)){
+    printf("Error spawning processes.\n");
+    return 1;
+  }
+
+  int misses = 0;
+  int answers = 0;
+  int winner = -1;
+  for(int tick = 0; tick < TEST_TICKS && winner < 0; ++tick){
+    send_ipc(state, procList, strms, shm, sendBuffers);
+    sleep_ms(TEST_BUSY_MS);
+    recv_ipc(state, playerInputs, procList, strms, shm, options);
+    for(int i = 0; i < numPlayers; ++i){
+      if(!procList[i].asked) continue;
+      if(procList[i].latency < 0){
+	printf("Tick %d: player %d (%s) missed its deadline\n", tick, i + 1, procList[i].path.c_str());
+	++misses;
+      }
+      else ++answers;
+    }
+    winner = snakeGameTick(state, playerInputs);
+  }
+  destroy_ipc(procList, strms, numPlayers);
+  destroy_shm(shm);
+
+  printf("%d answers, %d misses\n", answers, misses);
+  return misses == 0 && answers > 0 ? 0 : 1;
+}